@@ -0,0 +1,82 @@
+// Compares the two Component_manager storage modes on the bullet workload, the
+// way the game runs it: every frame a wave of bullets is fired from a
+// Bullet_pool (which grows with spawn_n<Bullet_bundle>), the pool's motion rows
+// are integrated and written back as by Physics, the changed Transforms are
+// visited (as by Transform_system) and the oldest bullets are released. Run
+// with `xmake run ecs-bench`.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <spdlog/spdlog.h>
+#include <tank-cli/ecs/bullet-pool.hpp>
+#include <tank-cli/ecs/component-manager.hpp>
+#include <tank-cli/ecs/components.hpp>
+#include <tank-cli/ecs/entity-manager.hpp>
+
+namespace {
+
+constexpr std::size_t frames{2000};
+constexpr std::size_t spawned_per_frame{64};
+constexpr std::size_t lifetime{120}; // Frames, so ~7700 bullets live at once
+constexpr float dt{1.F / 60};
+
+double run(Storage_mode mode)
+{
+    Entity_manager em;
+    Component_manager cm(mode);
+    Bullet_pool pool;
+    std::deque<Entity> alive;
+    float checksum{};
+
+    auto const start = std::chrono::steady_clock::now();
+    for (std::size_t frame{}; frame != frames; ++frame) {
+        for (std::size_t i{}; i != spawned_per_frame; ++i) {
+            auto const yaw = 0.01F * static_cast<float>(frame + i);
+            alive.push_back(pool.acquire(
+                em, cm, Transform{.position = {}, .yaw = yaw},
+                Velocity{.linear = 16, .angular = 0},
+                Renderable{.mesh = nullptr},
+                components::Expirable{.deadline = frame + lifetime}));
+        }
+
+        auto &motion = pool.motion();
+        motion.integrate(dt);
+        for (std::size_t i{}; i != motion.size(); ++i) {
+            motion.commit(i);
+        }
+        motion.turn_and_write_back(dt);
+        for (auto id : motion.ids()) {
+            cm.mark_changed<Transform>(id);
+        }
+
+        for (auto id : cm.view<Changed<Transform>>()) {
+            checksum += cm.read<Transform>(id).position.x;
+        }
+
+        while (!alive.empty() &&
+               cm.read<components::Expirable>(alive.front()).deadline ==
+                   frame) {
+            pool.release(cm, alive.front());
+            alive.pop_front();
+        }
+        cm.advance_tick();
+    }
+    std::chrono::duration<double, std::milli> const elapsed =
+        std::chrono::steady_clock::now() - start;
+    spdlog::debug("checksum {}, pool of {}", checksum, pool.capacity());
+    return elapsed.count();
+}
+
+} // namespace
+
+int main()
+{
+    for (auto mode : {Storage_mode::maps, Storage_mode::archetypes}) {
+        auto const ms = run(mode);
+        spdlog::info("{:>10}: {:8.2f} ms total, {:6.3f} ms per frame",
+                     mode == Storage_mode::maps ? "maps" : "archetypes", ms,
+                     ms / frames);
+    }
+}
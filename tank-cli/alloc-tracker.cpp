@@ -0,0 +1,78 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <spdlog/spdlog.h>
+#include <tank-cli/alloc-tracker.hpp>
+
+namespace {
+
+std::atomic<std::size_t> allocations;
+std::atomic<std::size_t> bytes;
+
+void *allocate(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    if (auto *p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+} // namespace
+
+// Replacements of the global allocation functions. Aligned and nothrow
+// variants aren't replaced, the defaults pair with each other.
+void *operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t /*size*/) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t /*size*/) noexcept
+{
+    std::free(p);
+}
+
+alloc_tracker::Stats alloc_tracker::totals()
+{
+    return {.allocations = allocations.load(std::memory_order_relaxed),
+            .bytes = bytes.load(std::memory_order_relaxed)};
+}
+
+void Frame_alloc_report::end_frame(std::size_t frame)
+{
+    auto frame_stats = alloc_tracker::totals() - frame_begin_;
+    if (frame_stats.allocations == 0) {
+        return;
+    }
+
+    spdlog::debug("frame {}: {} allocations, {} bytes", frame,
+                  frame_stats.allocations, frame_stats.bytes);
+    for (auto const &[system, stats] : std::span(systems_.data(), count_)) {
+        if (stats.allocations != 0) {
+            spdlog::debug("frame {}: system {}: {} allocations, {} bytes",
+                          frame, system, stats.allocations, stats.bytes);
+        }
+    }
+}
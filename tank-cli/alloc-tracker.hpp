@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <utility>
+
+// Counts heap allocations going through the global operator new. The counters
+// are process-wide; take two snapshots and subtract them to measure a region.
+namespace alloc_tracker {
+
+struct Stats {
+    std::size_t allocations{};
+    std::size_t bytes{};
+
+    Stats operator-(Stats const &rhs) const
+    {
+        return {.allocations = allocations - rhs.allocations,
+                .bytes = bytes - rhs.bytes};
+    }
+};
+
+/// @brief Allocations made since the program started.
+[[nodiscard]] Stats totals();
+
+} // namespace alloc_tracker
+
+// Measures allocations per system and per frame. Results are reported at the
+// end of each frame, so the logging itself never shows up in the numbers.
+class Frame_alloc_report {
+  public:
+    void begin_frame()
+    {
+        count_ = 0;
+        frame_begin_ = alloc_tracker::totals();
+    }
+
+    template <typename Fn> void measure(std::string_view system, Fn &&fn)
+    {
+        auto before = alloc_tracker::totals();
+        std::forward<Fn>(fn)();
+        if (count_ != systems_.size()) {
+            systems_[count_++] = {system, alloc_tracker::totals() - before};
+        }
+    }
+
+    void end_frame(std::size_t frame);
+
+  private:
+    static constexpr auto max_systems{16UZ};
+    std::array<std::pair<std::string_view, alloc_tracker::Stats>, max_systems>
+        systems_;
+    std::size_t count_{};
+    alloc_tracker::Stats frame_begin_;
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+
+// Model data compiled into the binary. Everything here is constexpr, including
+// the derived bounds and normals, so using a built-in mesh never builds
+// anything at runtime besides the GPU buffers.
+namespace builtin_meshes {
+
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+template <std::size_t Vertex_count, std::size_t Index_count> struct Mesh_data {
+    std::array<glm::vec3, Vertex_count> vertices;
+    std::array<std::uint32_t, Index_count> indices;
+};
+
+namespace detail {
+
+constexpr float sqrt(float x)
+{
+    if (x <= 0) {
+        return 0;
+    }
+    float r = x < 1 ? 1 : x;
+    for (int i{}; i != 32; ++i) {
+        r = (r + x / r) / 2;
+    }
+    return r;
+}
+
+constexpr glm::vec3 sub(glm::vec3 a, glm::vec3 b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+constexpr glm::vec3 add(glm::vec3 a, glm::vec3 b)
+{
+    return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+constexpr glm::vec3 cross(glm::vec3 a, glm::vec3 b)
+{
+    return {(a.y * b.z) - (a.z * b.y), (a.z * b.x) - (a.x * b.z),
+            (a.x * b.y) - (a.y * b.x)};
+}
+
+} // namespace detail
+
+template <std::size_t N, std::size_t M>
+constexpr Bounds bounds_of(Mesh_data<N, M> const &mesh)
+{
+    constexpr auto inf = std::numeric_limits<float>::infinity();
+    Bounds b{.min = {inf, inf, inf}, .max = {-inf, -inf, -inf}};
+    for (auto v : mesh.vertices) {
+        b.min = {std::min(b.min.x, v.x), std::min(b.min.y, v.y),
+                 std::min(b.min.z, v.z)};
+        b.max = {std::max(b.max.x, v.x), std::max(b.max.y, v.y),
+                 std::max(b.max.z, v.z)};
+    }
+    return b;
+}
+
+// Per-vertex normals: the area-weighted sum of adjacent face normals,
+// normalized. Winding of the index list decides the orientation.
+template <std::size_t N, std::size_t M>
+constexpr std::array<glm::vec3, N> normals_of(Mesh_data<N, M> const &mesh)
+{
+    static_assert(M % 3 == 0, "index list must consist of triangles");
+    std::array<glm::vec3, N> normals{};
+    for (std::size_t i{}; i != M; i += 3) {
+        auto a = mesh.indices[i];
+        auto b = mesh.indices[i + 1];
+        auto c = mesh.indices[i + 2];
+        auto face = detail::cross(
+            detail::sub(mesh.vertices[b], mesh.vertices[a]),
+            detail::sub(mesh.vertices[c], mesh.vertices[a]));
+        normals[a] = detail::add(normals[a], face);
+        normals[b] = detail::add(normals[b], face);
+        normals[c] = detail::add(normals[c], face);
+    }
+    for (auto &n : normals) {
+        auto len = detail::sqrt((n.x * n.x) + (n.y * n.y) + (n.z * n.z));
+        if (len != 0) {
+            n = {n.x / len, n.y / len, n.z / len};
+        }
+    }
+    return normals;
+}
+
+// 厚度
+inline constexpr float tank_height = 3.0F;
+
+inline constexpr Mesh_data<16, 72> tank{
+    .vertices = {{{6, tank_height, 3},
+                  {-6, tank_height, 3},
+                  {6, tank_height, -3},
+                  {-6, tank_height, -3},
+                  {0, tank_height, 1},
+                  {0, tank_height, -1},
+                  {9, tank_height, 1},
+                  {9, tank_height, -1},
+                  {6, 0, 3},
+                  {-6, 0, 3},
+                  {6, 0, -3},
+                  {-6, 0, -3},
+                  {0, 0, 1},
+                  {0, 0, -1},
+                  {9, 0, 1},
+                  {9, 0, -1}}},
+    .indices = {0,  1,  2,  1,  3,  2,  4,  5,  6,  5,  7,  6,  10, 9,  8,
+                10, 11, 9,  14, 13, 12, 14, 15, 13, 8,  9,  0,  0,  9,  1,
+                9,  11, 1,  1,  11, 3,  11, 10, 3,  3,  10, 2,  10, 8,  2,
+                2,  8,  0,  12, 14, 4,  4,  14, 6,  13, 5,  15, 15, 5,  7,
+                12, 4,  13, 13, 4,  5,  14, 15, 6,  6,  15, 7},
+};
+
+inline constexpr Mesh_data<8, 36> bullet{
+    .vertices = {{{-0.5F, -0.5F, -0.5F},
+                  {0.5F, -0.5F, -0.5F},
+                  {0.5F, 0.5F, -0.5F},
+                  {-0.5F, 0.5F, -0.5F},
+                  {-0.5F, -0.5F, 0.5F},
+                  {0.5F, -0.5F, 0.5F},
+                  {0.5F, 0.5F, 0.5F},
+                  {-0.5F, 0.5F, 0.5F}}},
+    .indices =
+        {
+            0, 1, 2, 2, 3, 0, // front face
+            4, 5, 6, 6, 7, 4, // back face
+            7, 3, 0, 0, 4, 7, // left face
+            6, 2, 1, 1, 5, 6, // right face
+            0, 1, 5, 5, 4, 0, // bottom face
+            3, 2, 6, 6, 7, 3  // top face
+        },
+};
+
+// 顶点定义一个沿 X 方向长度=1，沿 Z 方向厚度=1，高度=1 的盒子
+inline constexpr Mesh_data<8, 36> unit_box{
+    .vertices = {{{-0.5F, -0.5F, -0.5F},
+                  {+0.5F, -0.5F, -0.5F},
+                  {+0.5F, -0.5F, +0.5F},
+                  {-0.5F, -0.5F, +0.5F},
+                  {-0.5F, +0.5F, -0.5F},
+                  {+0.5F, +0.5F, -0.5F},
+                  {+0.5F, +0.5F, +0.5F},
+                  {-0.5F, +0.5F, +0.5F}}},
+    .indices =
+        {
+            0, 1, 2, 2, 3, 0, // bottom
+            4, 5, 6, 6, 7, 4, // top
+            0, 1, 5, 5, 4, 0, // front
+            2, 3, 7, 7, 6, 2, // back
+            1, 2, 6, 6, 5, 1, // right
+            3, 0, 4, 4, 7, 3  // left
+        },
+};
+
+inline constexpr Bounds tank_bounds = bounds_of(tank);
+inline constexpr auto tank_normals = normals_of(tank);
+inline constexpr Bounds bullet_bounds = bounds_of(bullet);
+inline constexpr auto bullet_normals = normals_of(bullet);
+inline constexpr Bounds unit_box_bounds = bounds_of(unit_box);
+inline constexpr auto unit_box_normals = normals_of(unit_box);
+
+} // namespace builtin_meshes
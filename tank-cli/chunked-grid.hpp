@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+// A width x height grid of T split into 64x64 chunks. A chunk whose cells are
+// all the same is just that value; only chunks with differing cells own an
+// array. Lookups are two-level: chunk table, then cell within the chunk.
+//
+// Uniform chunks are materialized lazily on the first write of a different
+// value, and compact() turns chunks that became uniform back into one value.
+template <typename T> class Chunked_grid {
+  public:
+    static constexpr int chunk_bits{6};
+    static constexpr int chunk_size{1 << chunk_bits};
+    static constexpr int chunk_mask{chunk_size - 1};
+    static constexpr std::size_t chunk_cells{chunk_size * chunk_size};
+
+    Chunked_grid(int width, int height, T fill)
+        : width_(width), height_(height),
+          chunks_x_((width + chunk_mask) >> chunk_bits),
+          chunks_z_((height + chunk_mask) >> chunk_bits),
+          chunks_(static_cast<std::size_t>(chunks_x_) * chunks_z_)
+    {
+        for (auto &c : chunks_) {
+            c.uniform = fill;
+        }
+    }
+
+    Chunked_grid(Chunked_grid const &) = delete;
+    Chunked_grid(Chunked_grid &&) noexcept = default;
+    Chunked_grid &operator=(Chunked_grid const &) = delete;
+    Chunked_grid &operator=(Chunked_grid &&) noexcept = default;
+    ~Chunked_grid() = default;
+
+    /// @brief No bounds check.
+    [[nodiscard]] T get(int x, int z) const
+    {
+        auto const &c = chunks_[chunk_index(x >> chunk_bits, z >> chunk_bits)];
+        return c.cells ? c.cells[cell_index(x, z)] : c.uniform;
+    }
+
+    /// @brief No bounds check. Writing the value a uniform chunk already
+    /// has doesn't allocate.
+    void set(int x, int z, T value)
+    {
+        auto &c = chunks_[chunk_index(x >> chunk_bits, z >> chunk_bits)];
+        if (!c.cells) {
+            if (c.uniform == value) {
+                return;
+            }
+            c.cells = std::make_unique<T[]>(chunk_cells);
+            std::fill_n(c.cells.get(), chunk_cells, c.uniform);
+        }
+        c.cells[cell_index(x, z)] = value;
+    }
+
+    /// @brief Collapses the chunks overlapping the cells [lo, hi] whose cells
+    /// are all equal back into a single value.
+    void compact(int lo_x, int lo_z, int hi_x, int hi_z)
+    {
+        auto const last_x = hi_x >> chunk_bits;
+        auto const last_z = hi_z >> chunk_bits;
+        for (int cz{lo_z >> chunk_bits}; cz <= last_z; ++cz) {
+            for (int cx{lo_x >> chunk_bits}; cx <= last_x; ++cx) {
+                compact_chunk(cx, cz);
+            }
+        }
+    }
+
+    [[nodiscard]] int chunks_x() const
+    {
+        return chunks_x_;
+    }
+
+    [[nodiscard]] int chunks_z() const
+    {
+        return chunks_z_;
+    }
+
+    /// @brief The cells of a chunk, row-major, or an empty span if the chunk
+    /// is uniform.
+    [[nodiscard]] std::span<T const> chunk_cells_of(int cx, int cz) const
+    {
+        auto const &c = chunks_[chunk_index(cx, cz)];
+        return c.cells ? std::span<T const>(c.cells.get(), chunk_cells)
+                       : std::span<T const>{};
+    }
+
+    [[nodiscard]] T chunk_uniform(int cx, int cz) const
+    {
+        return chunks_[chunk_index(cx, cz)].uniform;
+    }
+
+    /// @brief Replaces a chunk: with `uniform` if `cells` is empty, otherwise
+    /// with a copy of `cells` (chunk_cells values, row-major).
+    void assign_chunk(int cx, int cz, T uniform, std::span<T const> cells)
+    {
+        auto &c = chunks_[chunk_index(cx, cz)];
+        c.uniform = uniform;
+        if (cells.empty()) {
+            c.cells.reset();
+            return;
+        }
+        if (!c.cells) {
+            c.cells = std::make_unique<T[]>(chunk_cells);
+        }
+        std::copy_n(cells.begin(), chunk_cells, c.cells.get());
+    }
+
+    [[nodiscard]] std::size_t dense_chunk_count() const
+    {
+        return std::ranges::count_if(
+            chunks_, [](auto const &c) { return c.cells != nullptr; });
+    }
+
+  private:
+    struct Chunk {
+        std::unique_ptr<T[]> cells; // Null while the chunk is uniform
+        T uniform{};
+    };
+
+    int width_;
+    int height_;
+    int chunks_x_;
+    int chunks_z_;
+    std::vector<Chunk> chunks_;
+
+    [[nodiscard]] std::size_t chunk_index(int cx, int cz) const
+    {
+        return (static_cast<std::size_t>(cz) * chunks_x_) + cx;
+    }
+
+    [[nodiscard]] static std::size_t cell_index(int x, int z)
+    {
+        return (static_cast<std::size_t>(z & chunk_mask) << chunk_bits) +
+               (x & chunk_mask);
+    }
+
+    // Only cells inside the grid count, the padding of border chunks is
+    // ignored.
+    void compact_chunk(int cx, int cz)
+    {
+        auto &c = chunks_[chunk_index(cx, cz)];
+        if (!c.cells) {
+            return;
+        }
+        auto const first = c.cells[0];
+        int const w = std::min(chunk_size, width_ - (cx << chunk_bits));
+        int const h = std::min(chunk_size, height_ - (cz << chunk_bits));
+        for (int z{}; z != h; ++z) {
+            for (int x{}; x != w; ++x) {
+                if (!(c.cells[(z << chunk_bits) + x] == first)) {
+                    return;
+                }
+            }
+        }
+        c.uniform = first;
+        c.cells.reset();
+    }
+};
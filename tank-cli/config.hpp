@@ -1,6 +1,7 @@
 #include <fstream>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
+#include <tank-cli/ecs/component-manager.hpp>
 
 namespace fs = std::filesystem;
 
@@ -19,11 +20,19 @@ NLOHMANN_JSON_SERIALIZE_ENUM(level_enum, {
                                          });
 } // namespace spdlog::level
 
+NLOHMANN_JSON_SERIALIZE_ENUM(Storage_mode,
+                             {
+                                 {Storage_mode::maps, "maps"},
+                                 {Storage_mode::archetypes, "archetypes"},
+                             });
+
 struct Config {
   public:
     spdlog::level::level_enum log_level{spdlog::level::info};
+    // Component layout of the game's World, see Storage_mode.
+    Storage_mode ecs_storage{Storage_mode::maps};
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Config, log_level);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Config, log_level, ecs_storage);
 
     Config() = default;
     Config(nlohmann::json const &json)
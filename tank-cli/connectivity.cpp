@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <numeric>
+#include <tank-cli/connectivity.hpp>
+#include <tank-cli/map.hpp>
+#include <utility>
+
+Connectivity::Connectivity(int width, int height)
+    : labels_(width, height, none), slots_(width, height, none)
+{
+}
+
+namespace {
+
+// Union-find over the components of the chunks, with the number of cells
+// under every root.
+class Nodes {
+  public:
+    std::int32_t add()
+    {
+        auto const node = static_cast<std::int32_t>(parent_.size());
+        parent_.push_back(node);
+        cells_.push_back(0);
+        return node;
+    }
+
+    std::int32_t find(std::int32_t node)
+    {
+        while (parent_[node] != node) {
+            parent_[node] = parent_[parent_[node]];
+            node = parent_[node];
+        }
+        return node;
+    }
+
+    void unite(std::int32_t a, std::int32_t b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a == b) {
+            return;
+        }
+        if (cells_[a] < cells_[b]) {
+            std::swap(a, b);
+        }
+        parent_[b] = a;
+        cells_[a] += cells_[b];
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return parent_.size();
+    }
+
+    std::size_t &cells(std::int32_t node)
+    {
+        return cells_[node];
+    }
+
+  private:
+    std::vector<std::int32_t> parent_;
+    std::vector<std::size_t> cells_;
+};
+
+} // namespace
+
+// Units only move between movable cells, and a diagonal step needs both cells
+// it cuts past to be movable too, so 4-neighbours are enough to find the
+// components.
+//
+// Only chunk-sized scratch is used per cell: every chunk of the map is labelled
+// on its own into labels_, with a node per component, then the nodes touching
+// across chunk borders are united and labels_ is rewritten with the final
+// labels.
+void Connectivity::build(Map const &map)
+{
+    using Labels = Chunked_grid<std::int32_t>;
+    constexpr int chunk_size{Labels::chunk_size};
+    constexpr int chunk_bits{Labels::chunk_bits};
+    auto const w = map.width();
+    auto const h = map.height();
+    auto const &cells = map.cells();
+    labels_ = Labels(w, h, none);
+    slots_ = Labels(w, h, none);
+    sizes_.clear();
+    free_.clear();
+    largest_ = none;
+
+    Nodes nodes;
+    std::vector<std::uint16_t> parent(Labels::chunk_cells);
+    std::vector<std::int32_t> chunk(Labels::chunk_cells);
+    auto find = [&parent](std::uint16_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+    auto label_chunk = [&](int cx, int cz, int cw, int ch) {
+        auto const terrain = cells.chunk_cells_of(cx, cz);
+        if (terrain.empty()) {
+            if (cells.chunk_uniform(cx, cz).terrain() == Terrain::movable) {
+                auto const node = nodes.add();
+                nodes.cells(node) = static_cast<std::size_t>(cw) * ch;
+                labels_.assign_chunk(cx, cz, node, {});
+            }
+            return;
+        }
+        auto movable = [&terrain](int i) {
+            return terrain[i].terrain() == Terrain::movable;
+        };
+        std::iota(parent.begin(), parent.end(), 0);
+        for (int z{}; z != ch; ++z) {
+            for (int x{}; x != cw; ++x) {
+                auto const i = (z << chunk_bits) + x;
+                if (!movable(i)) {
+                    continue;
+                }
+                if (x != 0 && movable(i - 1)) {
+                    parent[find(i)] = find(i - 1);
+                }
+                if (z != 0 && movable(i - chunk_size)) {
+                    parent[find(i)] = find(i - chunk_size);
+                }
+            }
+        }
+        // chunk[] gives every root its node as soon as a cell under it is
+        // met; a root being one of those cells, it keeps that node.
+        std::ranges::fill(chunk, none);
+        for (int z{}; z != ch; ++z) {
+            for (int x{}; x != cw; ++x) {
+                auto const i = (z << chunk_bits) + x;
+                if (!movable(i)) {
+                    continue;
+                }
+                auto &node = chunk[find(i)];
+                if (node == none) {
+                    node = nodes.add();
+                }
+                chunk[i] = node;
+                ++nodes.cells(node);
+            }
+        }
+        labels_.assign_chunk(cx, cz, none, chunk);
+    };
+
+    for (int cz{}; cz != labels_.chunks_z(); ++cz) {
+        for (int cx{}; cx != labels_.chunks_x(); ++cx) {
+            label_chunk(cx, cz, std::min(chunk_size, w - (cx << chunk_bits)),
+                        std::min(chunk_size, h - (cz << chunk_bits)));
+        }
+    }
+
+    // Unite across the chunk borders.
+    auto unite = [&](glm::ivec2 a, glm::ivec2 b) {
+        auto const na = labels_.get(a.x, a.y);
+        auto const nb = labels_.get(b.x, b.y);
+        if (na != none && nb != none) {
+            nodes.unite(na, nb);
+        }
+    };
+    for (int x{chunk_size}; x < w; x += chunk_size) {
+        for (int z{}; z != h; ++z) {
+            unite({x - 1, z}, {x, z});
+        }
+    }
+    for (int z{chunk_size}; z < h; z += chunk_size) {
+        for (int x{}; x != w; ++x) {
+            unite({x, z - 1}, {x, z});
+        }
+    }
+
+    // Number the roots in chunk order.
+    std::vector<std::int32_t> root_label(nodes.size(), none);
+    auto relabel = [&](std::int32_t node) {
+        if (node == none) {
+            return none;
+        }
+        auto const root = nodes.find(node);
+        auto &label = root_label[root];
+        if (label == none) {
+            label = static_cast<std::int32_t>(sizes_.size());
+            sizes_.push_back(nodes.cells(root));
+            free_.emplace_back();
+        }
+        return label;
+    };
+    for (int cz{}; cz != labels_.chunks_z(); ++cz) {
+        for (int cx{}; cx != labels_.chunks_x(); ++cx) {
+            auto const node_cells = labels_.chunk_cells_of(cx, cz);
+            if (node_cells.empty()) {
+                labels_.assign_chunk(cx, cz,
+                                     relabel(labels_.chunk_uniform(cx, cz)),
+                                     {});
+                continue;
+            }
+            std::ranges::transform(node_cells, chunk.begin(), relabel);
+            labels_.assign_chunk(cx, cz, none, chunk);
+        }
+    }
+
+    // Gather the free cells, skipping the chunks without a movable one.
+    for (int cz{}; cz != labels_.chunks_z(); ++cz) {
+        for (int cx{}; cx != labels_.chunks_x(); ++cx) {
+            if (labels_.chunk_cells_of(cx, cz).empty() &&
+                labels_.chunk_uniform(cx, cz) == none) {
+                continue;
+            }
+            auto const x0 = cx << chunk_bits;
+            auto const z0 = cz << chunk_bits;
+            auto const x1 = std::min(x0 + chunk_size, w);
+            auto const z1 = std::min(z0 + chunk_size, h);
+            for (int z{z0}; z != z1; ++z) {
+                for (int x{x0}; x != x1; ++x) {
+                    auto const label = labels_.get(x, z);
+                    if (label == none || map.occupants({x, z}) != 0) {
+                        continue;
+                    }
+                    slots_.set(x, z,
+                               static_cast<std::int32_t>(free_[label].size()));
+                    free_[label].emplace_back(x, z);
+                }
+            }
+        }
+    }
+    labels_.compact(0, 0, w - 1, h - 1);
+
+    if (!sizes_.empty()) {
+        largest_ = static_cast<std::int32_t>(
+            std::ranges::max_element(sizes_) - sizes_.begin());
+    }
+}
+
+void Connectivity::remove_free(glm::ivec2 cell)
+{
+    auto const slot = slots_.get(cell.x, cell.y);
+    if (slot == none) {
+        return;
+    }
+    auto &cells = free_[label(cell)];
+    auto const last = cells.back();
+    cells[slot] = last;
+    slots_.set(last.x, last.y, slot);
+    cells.pop_back();
+    slots_.set(cell.x, cell.y, none);
+}
+
+void Connectivity::add_free(glm::ivec2 cell)
+{
+    auto const l = label(cell);
+    if (l == none || slots_.get(cell.x, cell.y) != none) {
+        return;
+    }
+    slots_.set(cell.x, cell.y, static_cast<std::int32_t>(free_[l].size()));
+    free_[l].push_back(cell);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <tank-cli/chunked-grid.hpp>
+#include <vector>
+
+class Map;
+
+// Connected components of the movable cells of a Map: which cells a unit can
+// get to from which. Labels are found with a union-find per 64x64 chunk of the
+// map, whose components (a uniform chunk being just one) are then united across
+// chunk borders, and stored per cell (chunked, so a big open area is one value
+// per chunk).
+//
+// Every component also keeps a compact array of its free (movable and
+// unoccupied) cells, with each cell's position in it, so occupying or freeing
+// a cell is a swap-remove or a push, and drawing a random free cell is one
+// index.
+class Connectivity {
+  public:
+    static constexpr std::int32_t none{-1};
+
+    Connectivity(int width, int height);
+
+    /// @brief Labels `map` from scratch, taking Map::occupants() into
+    /// account for the free cells.
+    void build(Map const &map);
+
+    /// @brief The component of `cell`, or `none` if it isn't movable. No
+    /// bounds check.
+    [[nodiscard]] std::int32_t label(glm::ivec2 cell) const
+    {
+        return labels_.get(cell.x, cell.y);
+    }
+
+    /// @brief Number of components.
+    [[nodiscard]] std::size_t size() const
+    {
+        return sizes_.size();
+    }
+
+    /// @brief Number of cells of a component, free or not.
+    [[nodiscard]] std::size_t cell_count(std::int32_t label) const
+    {
+        return sizes_[label];
+    }
+
+    /// @brief The free cells of a component, in no particular order.
+    [[nodiscard]] std::span<glm::ivec2 const>
+    free_cells(std::int32_t label) const
+    {
+        return free_[label];
+    }
+
+    /// @brief The component with the most cells, or `none` if no cell is
+    /// movable.
+    [[nodiscard]] std::int32_t largest() const
+    {
+        return largest_;
+    }
+
+    /// @brief Takes `cell` out of the free cells of its component, if it's
+    /// there. O(1).
+    void remove_free(glm::ivec2 cell);
+
+    /// @brief Puts a movable `cell` back into the free cells of its
+    /// component. O(1).
+    void add_free(glm::ivec2 cell);
+
+    /// @brief Removes and returns up to `n` distinct free cells of `label`,
+    /// drawn uniformly with `random() % k`. O(n).
+    template <typename Random>
+    std::vector<glm::ivec2> take_free(std::int32_t label, std::size_t n,
+                                      Random &&random)
+    {
+        auto const &cells = free_[label];
+        n = std::min(n, cells.size());
+        std::vector<glm::ivec2> taken;
+        taken.reserve(n);
+        for (std::size_t k{}; k != n; ++k) {
+            auto const cell = cells[random() % cells.size()];
+            taken.push_back(cell);
+            remove_free(cell);
+        }
+        return taken;
+    }
+
+  private:
+    Chunked_grid<std::int32_t> labels_;
+    // Index of every free cell in free_[its label], `none` for the others.
+    Chunked_grid<std::int32_t> slots_;
+    std::vector<std::size_t> sizes_;
+    std::vector<std::vector<glm::ivec2>> free_;
+    std::int32_t largest_{none};
+};
@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <bit>
+#include <numeric>
+#include <stdexcept>
+#include <tank-cli/ecs/archetype-storage.hpp>
+
+namespace {
+
+std::size_t align_up(std::size_t offset, std::size_t align)
+{
+    return (offset + align - 1) / align * align;
+}
+
+} // namespace
+
+Archetype_storage::Archetype::Archetype(Mask mask)
+    : mask_(mask), column_of_(max_components, none)
+{
+    for (auto m = mask; m != 0; m &= m - 1) {
+        auto const id = static_cast<Component_id>(std::countr_zero(m));
+        column_of_[id] = static_cast<std::uint32_t>(columns_.size());
+        columns_.push_back({.id = id,
+                            .info = component_info(id),
+                            .data = 0,
+                            .added = 0,
+                            .changed = 0});
+    }
+
+    // Lay a chunk out for `rows` rows, returning the bytes it takes.
+    auto layout = [this](std::size_t rows) {
+        auto offset = rows * sizeof(Entity);
+        for (auto &c : columns_) {
+            if (c.info.size != 0) {
+                offset = align_up(offset, c.info.align);
+                c.data = offset;
+                offset += rows * c.info.size;
+            }
+        }
+        offset = align_up(offset, alignof(std::uint64_t));
+        for (auto &c : columns_) {
+            c.added = offset;
+            offset += rows * sizeof(std::uint64_t);
+            c.changed = offset;
+            offset += rows * sizeof(std::uint64_t);
+        }
+        return offset;
+    };
+    auto row_bytes = sizeof(Entity);
+    for (auto const &c : columns_) {
+        row_bytes += c.info.size + (2 * sizeof(std::uint64_t));
+    }
+    capacity_ = chunk_bytes / row_bytes;
+    while (capacity_ > 1 && layout(capacity_) > chunk_bytes) {
+        --capacity_;
+    }
+    if (layout(capacity_) > chunk_bytes) {
+        throw std::runtime_error("components too big for an archetype chunk");
+    }
+}
+
+void Archetype_storage::Archetype::grow()
+{
+    if (spare_.empty()) {
+        chunks_.push_back(std::make_unique_for_overwrite<Chunk>());
+    }
+    else {
+        chunks_.push_back(std::move(spare_.back()));
+        spare_.pop_back();
+    }
+}
+
+std::size_t Archetype_storage::Archetype::push(Entity id)
+{
+    auto const row = size_++;
+    if (row / capacity_ == chunks_.size()) {
+        grow();
+    }
+    entity(row) = id;
+    return row;
+}
+
+Archetype_storage::~Archetype_storage()
+{
+    for (auto const &a : archetypes_) {
+        for (std::size_t row{}; row != a->size_; ++row) {
+            for (auto const &c : a->columns_) {
+                if (c.info.size != 0) {
+                    c.info.destroy(a->data(c, row));
+                }
+            }
+        }
+    }
+}
+
+std::uint32_t Archetype_storage::archetype(Mask mask)
+{
+    auto [it, inserted] = by_mask_.try_emplace(
+        mask, static_cast<std::uint32_t>(archetypes_.size()));
+    if (inserted) {
+        archetypes_.push_back(std::make_unique<Archetype>(mask));
+    }
+    return it->second;
+}
+
+Archetype_storage::Tick_lists &Archetype_storage::lists(Component_id component)
+{
+    if (component >= lists_.size()) {
+        lists_.resize(component + 1);
+    }
+    return lists_[component];
+}
+
+void *Archetype_storage::add(Entity id, Component_id component,
+                             std::uint64_t tick)
+{
+    if (id >= locations_.size()) {
+        locations_.resize(id + 1);
+    }
+    auto const from = locations_[id];
+    auto const old_mask = mask_of(id);
+    if ((old_mask & bit(component)) != 0) {
+        throw std::runtime_error("entity already contains that component");
+    }
+
+    auto const target = archetype(old_mask | bit(component));
+    auto &to = *archetypes_[target];
+    auto const row = to.push(id);
+    if (from.archetype != none) {
+        auto &a = *archetypes_[from.archetype];
+        for (auto const &c : a.columns_) {
+            auto const &d = to.columns_[to.column_of_[c.id]];
+            if (c.info.size != 0) {
+                c.info.relocate(a.data(c, from.row), to.data(d, row));
+            }
+            to.added(d, row) = a.added(c, from.row);
+            to.changed(d, row) = a.changed(c, from.row);
+        }
+        fill_hole(a, from.row);
+    }
+    locations_[id] = {.archetype = target,
+                      .row = static_cast<std::uint32_t>(row)};
+
+    auto const &c = to.columns_[to.column_of_[component]];
+    to.added(c, row) = tick;
+    to.changed(c, row) = tick;
+    auto &l = lists(component);
+    l.added.push_back(id);
+    l.changed.push_back(id);
+    return c.info.size != 0 ? to.data(c, row) : nullptr;
+}
+
+std::pair<std::size_t, std::size_t>
+Archetype_storage::reserve_n(std::span<Entity const> ids, Mask mask)
+{
+    for (auto id : ids) {
+        if (mask_of(id) != 0) {
+            throw std::runtime_error("entity already contains components");
+        }
+        if (id >= locations_.size()) {
+            locations_.resize(id + 1);
+        }
+    }
+    auto const target = archetype(mask);
+    auto &a = *archetypes_[target];
+    while (a.chunks_.size() * a.capacity_ < a.size_ + ids.size()) {
+        a.grow();
+    }
+    return {target, a.size_};
+}
+
+// Nothing left to allocate but the tick lists, so the rows can't be left half
+// committed.
+void Archetype_storage::commit_n(std::size_t archetype,
+                                 std::span<Entity const> ids,
+                                 std::uint64_t tick)
+{
+    auto const target = static_cast<std::uint32_t>(archetype);
+    auto &a = *archetypes_[target];
+    for (auto id : ids) {
+        auto const row = a.push(id);
+        locations_[id] = {.archetype = target,
+                          .row = static_cast<std::uint32_t>(row)};
+        for (auto const &c : a.columns_) {
+            a.added(c, row) = tick;
+            a.changed(c, row) = tick;
+        }
+    }
+    for (auto const &c : a.columns_) {
+        auto &l = lists(c.id);
+        l.added.insert(l.added.end(), ids.begin(), ids.end());
+        l.changed.insert(l.changed.end(), ids.begin(), ids.end());
+    }
+}
+
+void Archetype_storage::destroy(std::size_t archetype, std::size_t row,
+                                Mask components)
+{
+    auto const &a = *archetypes_[archetype];
+    for (auto const &c : a.columns_) {
+        if (c.info.size != 0 && (components & bit(c.id)) != 0) {
+            c.info.destroy(a.data(c, row));
+        }
+    }
+}
+
+std::pair<Archetype_storage::Archetype const *, std::uint32_t>
+Archetype_storage::find(Entity id, Component_id component) const
+{
+    if (id >= locations_.size() || locations_[id].archetype == none) {
+        return {nullptr, none};
+    }
+    auto const &a = *archetypes_[locations_[id].archetype];
+    return {&a, a.column_of_[component]};
+}
+
+void *Archetype_storage::get(Entity id, Component_id component,
+                             std::uint64_t tick)
+{
+    auto [a, column] = find(id, component);
+    if (column == none) {
+        throw std::out_of_range("entity doesn't contain that component");
+    }
+    auto const &c = a->columns_[column];
+    auto const row = locations_[id].row;
+    if (auto &changed = a->changed(c, row); changed != tick) {
+        changed = tick;
+        lists(component).changed.push_back(id);
+    }
+    return c.info.size != 0 ? a->data(c, row) : nullptr;
+}
+
+void const *Archetype_storage::read(Entity id, Component_id component) const
+{
+    auto [a, column] = find(id, component);
+    if (column == none) {
+        throw std::out_of_range("entity doesn't contain that component");
+    }
+    auto const &c = a->columns_[column];
+    return c.info.size != 0 ? a->data(c, locations_[id].row) : nullptr;
+}
+
+bool Archetype_storage::added_at(Entity id, Component_id component,
+                                 std::uint64_t tick) const
+{
+    auto [a, column] = find(id, component);
+    return column != none &&
+           a->added(a->columns_[column], locations_[id].row) == tick;
+}
+
+bool Archetype_storage::changed_at(Entity id, Component_id component,
+                                   std::uint64_t tick) const
+{
+    auto [a, column] = find(id, component);
+    return column != none &&
+           a->changed(a->columns_[column], locations_[id].row) == tick;
+}
+
+void Archetype_storage::remove(Entity id)
+{
+    if (id >= locations_.size() || locations_[id].archetype == none) {
+        return;
+    }
+    auto const location = locations_[id];
+    auto const row = location.row;
+    auto &a = *archetypes_[location.archetype];
+    for (auto const &c : a.columns_) {
+        if (c.info.size != 0) {
+            c.info.destroy(a.data(c, row));
+        }
+        lists(c.id).removed.push_back(id);
+    }
+    fill_hole(a, row);
+    locations_[id] = {};
+}
+
+void Archetype_storage::fill_hole(Archetype &a, std::size_t row)
+{
+    auto const last = --a.size_;
+    if (row == last) {
+        return;
+    }
+    for (auto const &c : a.columns_) {
+        if (c.info.size != 0) {
+            c.info.relocate(a.data(c, last), a.data(c, row));
+        }
+        a.added(c, row) = a.added(c, last);
+        a.changed(c, row) = a.changed(c, last);
+    }
+    auto const moved = a.entity(last);
+    a.entity(row) = moved;
+    locations_[moved].row = static_cast<std::uint32_t>(row);
+}
+
+void Archetype_storage::clear_ticks()
+{
+    for (auto &l : lists_) {
+        l.added.clear();
+        l.changed.clear();
+        l.removed.clear();
+    }
+}
+
+// Rows are moved into fresh chunks in their new order, rather than permuted in
+// place, so every component is relocated exactly once.
+bool Archetype_storage::sort_rows(std::size_t archetype,
+                                  std::span<std::uint64_t const> keys)
+{
+    auto &a = *archetypes_[archetype];
+    if (keys.size() != a.size_) {
+        throw std::invalid_argument("one key per row expected");
+    }
+    if (std::ranges::is_sorted(keys)) {
+        return false;
+    }
+    order_.resize(a.size_);
+    std::iota(order_.begin(), order_.end(), 0);
+    std::ranges::stable_sort(order_, {}, [keys](auto r) { return keys[r]; });
+
+    auto old = std::move(a.chunks_);
+    a.chunks_.clear();
+    while (a.chunks_.size() != a.chunk_count()) {
+        a.grow();
+    }
+    for (std::size_t row{}; row != a.size_; ++row) {
+        auto const from = order_[row];
+        auto const id = *reinterpret_cast<Entity *>(
+            a.at(old, from, 0, sizeof(Entity)));
+        a.entity(row) = id;
+        locations_[id].row = static_cast<std::uint32_t>(row);
+        for (auto const &c : a.columns_) {
+            if (c.info.size != 0) {
+                c.info.relocate(a.at(old, from, c.data, c.info.size),
+                                a.data(c, row));
+            }
+            a.added(c, row) = *reinterpret_cast<std::uint64_t *>(
+                a.at(old, from, c.added, sizeof(std::uint64_t)));
+            a.changed(c, row) = *reinterpret_cast<std::uint64_t *>(
+                a.at(old, from, c.changed, sizeof(std::uint64_t)));
+        }
+    }
+    for (auto &chunk : old) {
+        a.spare_.push_back(std::move(chunk));
+    }
+    return true;
+}
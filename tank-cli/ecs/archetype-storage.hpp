@@ -0,0 +1,268 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <tank-cli/ecs/component-id.hpp>
+#include <tank-cli/ecs/entity.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Component storage grouping entities by their exact set of components (their
+// archetype). The entities of an archetype are packed into 16 KB chunks, each
+// holding its rows' ids, then every component as a contiguous array, then the
+// added/changed ticks of every component. Empty components take no space; an
+// archetype knowing it has them is enough.
+//
+// Adding a component moves the entity to another archetype, and removing an
+// entity moves the last row of its archetype into the hole, so component
+// addresses only stay valid until the next structural change.
+class Archetype_storage {
+  public:
+    using Mask = std::uint64_t;
+
+    static constexpr std::size_t chunk_bytes{16 * 1024};
+    static constexpr std::uint32_t none{~std::uint32_t{}};
+
+    class Archetype {
+      public:
+        explicit Archetype(Mask mask);
+
+        [[nodiscard]] Mask mask() const
+        {
+            return mask_;
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return size_;
+        }
+
+        [[nodiscard]] std::size_t chunk_count() const
+        {
+            return (size_ + capacity_ - 1) / capacity_;
+        }
+
+        /// @brief Chunk `c` of the array of a component in the mask. Empty
+        /// components have no array.
+        [[nodiscard]] void const *column(Component_id component,
+                                         std::size_t c) const
+        {
+            return chunks_[c]->bytes + columns_[column_of_[component]].data;
+        }
+
+        /// @brief The ids of the rows of chunk `c`.
+        [[nodiscard]] std::span<Entity const> entities(std::size_t c) const
+        {
+            auto const rows = c + 1 == chunk_count() ? size_ - (c * capacity_)
+                                                     : capacity_;
+            return {reinterpret_cast<Entity const *>(chunks_[c].get()), rows};
+        }
+
+      private:
+        friend class Archetype_storage;
+
+        struct Column {
+            Component_id id;
+            Component_info info;
+            std::size_t data;    // Offsets of the arrays in a chunk
+            std::size_t added;
+            std::size_t changed;
+        };
+
+        struct alignas(64) Chunk {
+            std::byte bytes[chunk_bytes];
+        };
+
+        Mask mask_;
+        std::vector<Column> columns_;
+        // Column of every component id, `none` for those not in the mask.
+        std::vector<std::uint32_t> column_of_;
+        std::size_t capacity_{}; // Rows per chunk
+        std::size_t size_{};
+        std::vector<std::unique_ptr<Chunk>> chunks_;
+        // Chunks left over from sort_rows(), reused before allocating.
+        std::vector<std::unique_ptr<Chunk>> spare_;
+
+        [[nodiscard]] std::byte *
+        at(std::vector<std::unique_ptr<Chunk>> const &chunks, std::size_t row,
+           std::size_t offset, std::size_t size) const
+        {
+            return chunks[row / capacity_]->bytes + offset +
+                   ((row % capacity_) * size);
+        }
+
+        [[nodiscard]] std::byte *at(std::size_t row, std::size_t offset,
+                                    std::size_t size) const
+        {
+            return at(chunks_, row, offset, size);
+        }
+
+        void grow();
+
+        Entity &entity(std::size_t row) const
+        {
+            return *reinterpret_cast<Entity *>(at(row, 0, sizeof(Entity)));
+        }
+
+        [[nodiscard]] void *data(Column const &c, std::size_t row) const
+        {
+            return at(row, c.data, c.info.size);
+        }
+
+        std::uint64_t &added(Column const &c, std::size_t row) const
+        {
+            return *reinterpret_cast<std::uint64_t *>(
+                at(row, c.added, sizeof(std::uint64_t)));
+        }
+
+        std::uint64_t &changed(Column const &c, std::size_t row) const
+        {
+            return *reinterpret_cast<std::uint64_t *>(
+                at(row, c.changed, sizeof(std::uint64_t)));
+        }
+
+        /// @return The new row, with its components left to construct.
+        std::size_t push(Entity id);
+    };
+
+    Archetype_storage() = default;
+    Archetype_storage(Archetype_storage const &) = delete;
+    Archetype_storage &operator=(Archetype_storage const &) = delete;
+    Archetype_storage(Archetype_storage &&) = default;
+    Archetype_storage &operator=(Archetype_storage &&) = default;
+    ~Archetype_storage();
+
+    /// @brief Moves `id` to the archetype with `component` too, stamping it
+    /// with `tick`.
+    /// @return Where to construct the component, nullptr if it's empty
+    /// @throws std::runtime_error if `id` has that component already
+    void *add(Entity id, Component_id component, std::uint64_t tick);
+
+    /// @brief Makes room for the entities of `ids`, which must have no
+    /// components yet, past the end of the archetype of `mask`. The rows
+    /// don't exist until commit_n(); their components are constructed in
+    /// between (see data()), and destroy()ed again if that fails.
+    /// @return The archetype and the first row
+    /// @throws std::runtime_error if an entity has components already
+    std::pair<std::size_t, std::size_t>
+    reserve_n(std::span<Entity const> ids, Mask mask);
+
+    /// @brief Puts the entities of reserve_n() in their rows, whose
+    /// components are all constructed by now, stamped with `tick`.
+    void commit_n(std::size_t archetype, std::span<Entity const> ids,
+                  std::uint64_t tick);
+
+    /// @brief Destroys the components of `row` in `components`, for rows
+    /// that reserve_n() made and won't be committed.
+    void destroy(std::size_t archetype, std::size_t row, Mask components);
+
+    /// @brief Where the component of a row of an archetype is.
+    [[nodiscard]] void *data(std::size_t archetype, Component_id component,
+                             std::size_t row) const
+    {
+        auto const &a = *archetypes_[archetype];
+        return a.data(a.columns_[a.column_of_[component]], row);
+    }
+
+    [[nodiscard]] bool contains(Entity id, Component_id component) const
+    {
+        return (mask_of(id) & bit(component)) != 0;
+    }
+
+    /// @brief The component of `id`, stamped as changed at `tick`.
+    /// @throws std::out_of_range if `id` doesn't have it
+    void *get(Entity id, Component_id component, std::uint64_t tick);
+
+    /// @throws std::out_of_range if `id` doesn't have the component
+    [[nodiscard]] void const *read(Entity id, Component_id component) const;
+
+    void mark_changed(Entity id, Component_id component, std::uint64_t tick)
+    {
+        get(id, component, tick);
+    }
+
+    [[nodiscard]] bool added_at(Entity id, Component_id component,
+                                std::uint64_t tick) const;
+    [[nodiscard]] bool changed_at(Entity id, Component_id component,
+                                  std::uint64_t tick) const;
+
+    /// @brief Destroys every component of `id`.
+    void remove(Entity id);
+
+    [[nodiscard]] Mask mask_of(Entity id) const
+    {
+        return id < locations_.size() && locations_[id].archetype != none
+                   ? archetypes_[locations_[id].archetype]->mask()
+                   : 0;
+    }
+
+    [[nodiscard]] std::span<std::unique_ptr<Archetype> const>
+    archetypes() const
+    {
+        return archetypes_;
+    }
+
+    // Entities added, written or removed during the current tick, per
+    // component, as in Component_storage.
+    [[nodiscard]] std::span<Entity const> added(Component_id component) const
+    {
+        return component < lists_.size() ? lists_[component].added
+                                         : std::span<Entity const>{};
+    }
+
+    [[nodiscard]] std::span<Entity const>
+    changed(Component_id component) const
+    {
+        return component < lists_.size() ? lists_[component].changed
+                                         : std::span<Entity const>{};
+    }
+
+    [[nodiscard]] std::span<Entity const>
+    removed(Component_id component) const
+    {
+        return component < lists_.size() ? lists_[component].removed
+                                         : std::span<Entity const>{};
+    }
+
+    void clear_ticks();
+
+    /// @brief Reorders the rows of archetype `archetype` by ascending `keys`,
+    /// one per row. Every component of a row moves with it.
+    /// @return Whether any row moved
+    bool sort_rows(std::size_t archetype, std::span<std::uint64_t const> keys);
+
+    [[nodiscard]] static Mask bit(Component_id component)
+    {
+        return Mask{1} << component;
+    }
+
+  private:
+    struct Location {
+        std::uint32_t archetype{none};
+        std::uint32_t row{};
+    };
+
+    struct Tick_lists {
+        std::vector<Entity> added;
+        std::vector<Entity> changed;
+        std::vector<Entity> removed;
+    };
+
+    // Entities are dense, see Entity_manager, so locations are indexed by id.
+    std::vector<Location> locations_;
+    std::vector<std::unique_ptr<Archetype>> archetypes_;
+    std::unordered_map<Mask, std::uint32_t> by_mask_;
+    std::vector<Tick_lists> lists_;
+    std::vector<std::uint32_t> order_; // Scratch of sort_rows()
+
+    std::uint32_t archetype(Mask mask);
+    Tick_lists &lists(Component_id component);
+    /// @brief Moves the last row of `a` into `row`, whose components have
+    /// been destroyed or moved out.
+    void fill_hole(Archetype &a, std::size_t row);
+    [[nodiscard]] std::pair<Archetype const *, std::uint32_t>
+    find(Entity id, Component_id component) const;
+};
@@ -0,0 +1,54 @@
+#include <spdlog/spdlog.h>
+#include <tank-cli/ecs/bullet-pool.hpp>
+#include <tank-cli/ecs/bundles.hpp>
+#include <tank-cli/ecs/component-manager.hpp>
+
+Entity Bullet_pool::acquire(Entity_manager &em, Component_manager &cm,
+                            Transform t, Velocity v, Renderable r,
+                            components::Expirable e)
+{
+    if (free_.empty()) {
+        grow(em, cm);
+    }
+    auto id = free_.back();
+    free_.pop_back();
+
+    cm.get<Transform>(id) = t;
+    cm.get<Velocity>(id) = v;
+    cm.get<Renderable>(id) = r;
+    cm.get<components::Expirable>(id) = e;
+    cm.set_enabled(id, true);
+    motion_.add(id, cm.get<Transform>(id), v);
+    return id;
+}
+
+void Bullet_pool::release(Component_manager &cm, Entity id)
+{
+    if (!cm.is_enabled(id)) {
+        return;
+    }
+    cm.set_enabled(id, false);
+    motion_.remove(id);
+    free_.push_back(id);
+}
+
+void Bullet_pool::grow(Entity_manager &em, Component_manager &cm)
+{
+    spdlog::debug("Bullet_pool grows from {} to {} bullets", capacity_,
+                  capacity_ + chunk_size_);
+    capacity_ += chunk_size_;
+    free_.reserve(capacity_);
+    // World_matrix is in the bundle so Transform_system never has to add
+    // it, see Motion_soa.
+    Bullet_bundle const prefab(Bullet_tag{}, Transform{}, World_matrix{},
+                               Velocity{.linear = 0, .angular = 0},
+                               Renderable{.mesh = nullptr},
+                               components::Expirable{.deadline = 0});
+    auto const ids =
+        spawn_n<Bullet_bundle>(em, cm, chunk_size_,
+                               [&](std::size_t /*i*/) { return prefab; });
+    for (auto id : ids) {
+        cm.set_enabled(id, false);
+        free_.push_back(id);
+    }
+}
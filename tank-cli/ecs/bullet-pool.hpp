@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <tank-cli/ecs/components.hpp>
+#include <tank-cli/ecs/entity-manager.hpp>
+#include <tank-cli/ecs/entity.hpp>
+#include <tank-cli/ecs/motion-soa.hpp>
+#include <vector>
+
+class Component_manager;
+
+// Recycles bullet entities. A released bullet keeps its components and is only
+// disabled, so firing again overwrites existing slots instead of inserting into
+// and erasing from every storage. The pool grows by whole chunks.
+//
+// Active bullets also have a row in motion(), which is how Physics moves them.
+class Bullet_pool {
+  public:
+    explicit Bullet_pool(std::size_t chunk_size = 64) : chunk_size_(chunk_size)
+    {
+    }
+
+    /// @brief Activates a bullet with the given components, growing the pool
+    /// if no free bullet is left.
+    Entity acquire(Entity_manager &em, Component_manager &cm, Transform t,
+                   Velocity v, Renderable r, components::Expirable e);
+
+    /// @brief Deactivates the bullet. Releasing an inactive bullet is a no-op.
+    void release(Component_manager &cm, Entity id);
+
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    [[nodiscard]] std::size_t active() const
+    {
+        return capacity_ - free_.size();
+    }
+
+    [[nodiscard]] Motion_soa &motion()
+    {
+        return motion_;
+    }
+
+  private:
+    std::size_t chunk_size_;
+    std::size_t capacity_{};
+    std::vector<Entity> free_;
+    Motion_soa motion_;
+
+    void grow(Entity_manager &em, Component_manager &cm);
+};
@@ -1 +1,54 @@
 #pragma once
+
+#include <cstddef>
+#include <tank-cli/ecs/component-manager.hpp>
+#include <tank-cli/ecs/components.hpp>
+#include <tank-cli/ecs/entity-manager.hpp>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// A set of components spawned together, declared once per kind of entity.
+// Used as a prefab: build one with the shared values, and copy it with the
+// per-entity values changed in spawn_n()'s init function.
+template <typename... Components> struct Bundle {
+    std::tuple<Components...> components;
+
+    Bundle() = default;
+    explicit Bundle(Components... c) : components(std::move(c)...) {}
+
+    template <typename T> T &get()
+    {
+        return std::get<T>(components);
+    }
+};
+
+template <typename Tag>
+using Tank_bundle = Bundle<Tank_tag, Tag, Transform, Velocity,
+                           components::Weapon, Renderable>;
+
+// Pooled bullets get every component up front, see Bullet_pool and
+// Motion_soa.
+using Bullet_bundle = Bundle<Bullet_tag, Transform, World_matrix, Velocity,
+                             Renderable, components::Expirable>;
+
+/// @brief Spawns `count` entities with the components of B, those of the
+/// i-th returned by `init(i)` as a B. Every storage is reserved once for the
+/// whole batch, see Component_manager::add_n.
+/// @return The new entities, in order
+template <typename B, typename Init>
+std::vector<Entity> spawn_n(Entity_manager &em, Component_manager &cm,
+                            std::size_t count, Init &&init)
+{
+    std::vector<Entity> ids(count);
+    for (auto &id : ids) {
+        id = em.make();
+    }
+    [&]<typename... Components>(std::tuple<Components...> const * /*unused*/) {
+        cm.add_n<Components...>(ids, [&](std::size_t i) {
+            B instance = init(i);
+            return std::move(instance.components);
+        });
+    }(static_cast<decltype(B::components) const *>(nullptr));
+    return ids;
+}
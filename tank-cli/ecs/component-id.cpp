@@ -0,0 +1,34 @@
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <tank-cli/ecs/component-id.hpp>
+
+namespace {
+
+// A deque, so the infos handed out stay put when more types register.
+std::deque<Component_info> &registry()
+{
+    static std::deque<Component_info> infos;
+    return infos;
+}
+
+std::mutex registry_mutex;
+
+} // namespace
+
+Component_id register_component(Component_info info)
+{
+    std::scoped_lock lock(registry_mutex);
+    auto &infos = registry();
+    if (infos.size() == max_components) {
+        throw std::runtime_error("too many component types");
+    }
+    infos.push_back(info);
+    return static_cast<Component_id>(infos.size() - 1);
+}
+
+Component_info const &component_info(Component_id id)
+{
+    std::scoped_lock lock(registry_mutex);
+    return registry()[id];
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Dense ids for component types, so storages can be kept in arrays and sets of
+// components fit in a mask. Ids are handed out in order of first use.
+using Component_id = std::uint32_t;
+
+// What the type-erased storages need to know about a component.
+struct Component_info {
+    std::size_t size;  // 0 for empty types, which are never stored
+    std::size_t align;
+    // Move-constructs the component at `to` from the one at `from`, then
+    // destroys the latter.
+    void (*relocate)(void *from, void *to);
+    void (*destroy)(void *component);
+};
+
+// Component sets are 64-bit masks.
+inline constexpr std::size_t max_components{64};
+
+/// @brief Registers a new component type.
+/// @throws std::runtime_error when there are max_components already
+Component_id register_component(Component_info info);
+
+[[nodiscard]] Component_info const &component_info(Component_id id);
+
+template <typename T> [[nodiscard]] Component_id component_id()
+{
+    static Component_id const id = register_component({
+        .size = std::is_empty_v<T> ? 0 : sizeof(T),
+        .align = alignof(T),
+        .relocate =
+            [](void *from, void *to) {
+                auto *source = static_cast<T *>(from);
+                std::construct_at(static_cast<T *>(to), std::move(*source));
+                std::destroy_at(source);
+            },
+        .destroy = [](void *p) { std::destroy_at(static_cast<T *>(p)); },
+    });
+    return id;
+}
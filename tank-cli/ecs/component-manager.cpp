@@ -1,19 +1,34 @@
 #include <tank-cli/ecs/component-manager.hpp>
-#include <tank-cli/ecs/components.hpp>
 
-// Remember to update this list once added some components! (hint use reflection
-// to implement this)
 void Component_manager::remove(Entity id)
 {
-    storage<Barrier_tag>().remove(id);
-    storage<Bot_tag>().remove(id);
-    storage<Bullet_tag>().remove(id);
-    storage<Player_tag>().remove(id);
-    storage<Tank_tag>().remove(id);
+    if (mode_ == Storage_mode::archetypes) {
+        archetypes_.remove(id);
+        return;
+    }
+    for (auto const &s : storages_) {
+        if (s) {
+            s->remove(id);
+        }
+    }
+}
 
-    storage<Transform>().remove(id);
-    storage<Velocity>().remove(id);
-    storage<Renderable>().remove(id);
-    storage<components::Weapon>().remove(id);
-    storage<components::Expirable>().remove(id);
+void Component_manager::advance_tick()
+{
+    for (auto const &o : observers_) {
+        if (o.flush != nullptr) {
+            o.flush(*this, o);
+        }
+    }
+    if (mode_ == Storage_mode::archetypes) {
+        archetypes_.clear_ticks();
+    }
+    else {
+        for (auto const &s : storages_) {
+            if (s) {
+                s->clear_tick();
+            }
+        }
+    }
+    ++tick_;
 }
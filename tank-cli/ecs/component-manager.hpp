@@ -1,20 +1,88 @@
 #pragma once
 
-#include <ranges>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <span>
 #include <stdexcept>
+#include <tank-cli/ecs/archetype-storage.hpp>
+#include <tank-cli/ecs/component-id.hpp>
 #include <tank-cli/ecs/entity.hpp>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
-template <typename T> class Component_storage {
+// View filters: Changed<T> matches the entities whose T was added or written
+// through a mutable accessor during the current tick, Added<T> those whose T
+// was added during it. Either can stand wherever a component type can in
+// Component_manager::view(); in first place, only those entities are visited,
+// and T mustn't be added to or written while iterating.
+template <typename T> struct Changed {};
+template <typename T> struct Added {};
+
+template <typename T> inline constexpr bool is_tick_filter_v = false;
+template <typename T>
+inline constexpr bool is_tick_filter_v<Changed<T>> = true;
+template <typename T> inline constexpr bool is_tick_filter_v<Added<T>> = true;
+
+// View filters on other components: Without<Ts...> matches the entities having
+// none of Ts, Any_of<Ts...> those having at least one. They narrow a view, so
+// they can't come first in it.
+template <typename... Ts> struct Without {};
+template <typename... Ts> struct Any_of {};
+
+// How a Component_manager lays its components out: a hash map per component
+// type (a bitset for empty ones), or entities grouped by archetype in chunks
+// (see Archetype_storage).
+//
+// The game runs on maps (see config.json). With bullets pooled, the hot path no
+// longer creates or destroys entities, and bench/ecs-storage.cpp puts the two
+// modes within noise of each other, so the simpler one stays the default.
+// Archetypes remains selectable; only there does sort_step() reorder anything.
+enum class Storage_mode : std::uint8_t { maps, archetypes };
+
+class Component_storage_base {
   public:
-    void add(Entity id, T comp)
+    Component_storage_base() = default;
+    Component_storage_base(Component_storage_base const &) = delete;
+    Component_storage_base &operator=(Component_storage_base const &) = delete;
+    Component_storage_base(Component_storage_base &&) = delete;
+    Component_storage_base &operator=(Component_storage_base &&) = delete;
+    virtual ~Component_storage_base() = default;
+
+    virtual void remove(Entity id) = 0;
+    virtual void clear_tick() = 0;
+};
+
+// Every entry remembers the tick it was added at and the tick of its latest
+// write. The first write of a tick also lists the entity in changed(), so the
+// entities that changed can be visited without scanning the storage. The
+// added(), changed() and removed() lists cover the current tick only; an
+// entity removed and added again within a tick may be listed twice.
+template <typename T> class Component_storage : public Component_storage_base {
+  public:
+    struct Entry {
+        T value;
+        std::uint64_t added;
+        std::uint64_t changed;
+        std::size_t slot; // Index in ids()
+    };
+
+    void add(Entity id, T comp, std::uint64_t tick)
     {
-        if (entities_.contains(id)) {
+        auto [it, inserted] = entities_.try_emplace(
+            id, Entry{std::move(comp), tick, tick, ids_.size()});
+        if (!inserted) {
             throw std::runtime_error("entity already contains that component");
         }
-        entities_.emplace(id, std::move(comp));
-        // data_[id] = std::move(comp);
+        ids_.push_back(id);
+        added_.push_back(id);
+        changed_.push_back(id);
     }
 
     [[nodiscard]] bool contains(Entity id) const
@@ -22,69 +90,985 @@ template <typename T> class Component_storage {
         return entities_.contains(id);
     }
 
-    T &get(Entity id)
+    /// @brief Makes room for `n` more entities, so adding them neither
+    /// rehashes nor reallocates.
+    void reserve(std::size_t n)
+    {
+        entities_.reserve(entities_.size() + n);
+        ids_.reserve(ids_.size() + n);
+        added_.reserve(added_.size() + n);
+        changed_.reserve(changed_.size() + n);
+    }
+
+    T &get(Entity id, std::uint64_t tick)
+    {
+        auto &entry = entities_.at(id);
+        stamp(id, entry, tick);
+        return entry.value;
+    }
+
+    [[nodiscard]] T const &read(Entity id) const
+    {
+        return entities_.at(id).value;
+    }
+
+    /// @brief Stamps the entry of `id` as written, for writes that didn't go
+    /// through get().
+    void mark_changed(Entity id, std::uint64_t tick)
+    {
+        stamp(id, entities_.at(id), tick);
+    }
+
+    [[nodiscard]] bool added_at(Entity id, std::uint64_t tick) const
+    {
+        auto it = entities_.find(id);
+        return it != entities_.end() && it->second.added == tick;
+    }
+
+    [[nodiscard]] bool changed_at(Entity id, std::uint64_t tick) const
+    {
+        auto it = entities_.find(id);
+        return it != entities_.end() && it->second.changed == tick;
+    }
+
+    void remove(Entity id) override
+    {
+        auto it = entities_.find(id);
+        if (it == entities_.end()) {
+            return;
+        }
+        auto const slot = it->second.slot;
+        entities_.erase(it);
+        ids_[slot] = ids_.back();
+        ids_.pop_back();
+        if (slot != ids_.size()) {
+            entities_.at(ids_[slot]).slot = slot;
+        }
+        removed_.push_back(id);
+    }
+
+    /// @brief Every entity with the component, in no particular order.
+    [[nodiscard]] std::span<Entity const> ids() const
+    {
+        return ids_;
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return ids_.size();
+    }
+
+    [[nodiscard]] std::span<Entity const> added() const
+    {
+        return added_;
+    }
+
+    [[nodiscard]] std::span<Entity const> changed() const
+    {
+        return changed_;
+    }
+
+    [[nodiscard]] std::span<Entity const> removed() const
+    {
+        return removed_;
+    }
+
+    /// @brief Empties the per-tick lists, keeping their capacity.
+    void clear_tick() override
+    {
+        added_.clear();
+        changed_.clear();
+        removed_.clear();
+    }
+
+  private:
+    std::unordered_map<Entity, Entry> entities_;
+    std::vector<Entity> ids_;
+    std::vector<Entity> added_;
+    std::vector<Entity> changed_;
+    std::vector<Entity> removed_;
+
+    void stamp(Entity id, Entry &entry, std::uint64_t tick)
+    {
+        if (entry.changed != tick) {
+            entry.changed = tick;
+            changed_.push_back(id);
+        }
+    }
+};
+
+// Empty components, the tags, are a bit per entity instead of map entries:
+// testing for one is a shift and a mask. Only the adds and writes of the
+// current tick are remembered, as bits as well, since views never ask about
+// older ones; the tick passed to added_at() and changed_at() must be the
+// current one.
+//
+// The entities having one are also kept in a dense list, swap-removed through
+// their slot in it (indexed by entity like the bits), rather than gathered from
+// the bits a word at a time with size() a popcount. Entity ids are never
+// reused, so those scans would cover every id ever issued, on every view and
+// count; and a view trusts the list it's led by without testing its entities
+// again, so the list can't lag behind removals. That costs 4 bytes per entity
+// id on top of the bits.
+template <typename T>
+    requires std::is_empty_v<T>
+class Component_storage<T> : public Component_storage_base {
+  public:
+    void add(Entity id, T /*comp*/, std::uint64_t /*tick*/)
+    {
+        if (test(present_, id)) {
+            throw std::runtime_error("entity already contains that component");
+        }
+        set(present_, id);
+        set(added_now_, id);
+        set(changed_now_, id);
+        if (id >= slots_.size()) {
+            slots_.resize(id + 1);
+        }
+        slots_[id] = static_cast<std::uint32_t>(ids_.size());
+        ids_.push_back(id);
+        added_.push_back(id);
+        changed_.push_back(id);
+    }
+
+    [[nodiscard]] bool contains(Entity id) const
+    {
+        return test(present_, id);
+    }
+
+    void reserve(std::size_t n)
+    {
+        ids_.reserve(ids_.size() + n);
+        added_.reserve(added_.size() + n);
+        changed_.reserve(changed_.size() + n);
+    }
+
+    T &get(Entity id, std::uint64_t tick)
+    {
+        mark_changed(id, tick);
+        return value_;
+    }
+
+    [[nodiscard]] T const &read(Entity id) const
+    {
+        if (!contains(id)) {
+            throw std::out_of_range("entity doesn't contain that component");
+        }
+        return value_;
+    }
+
+    void mark_changed(Entity id, std::uint64_t /*tick*/)
+    {
+        if (!contains(id)) {
+            throw std::out_of_range("entity doesn't contain that component");
+        }
+        if (!test(changed_now_, id)) {
+            set(changed_now_, id);
+            changed_.push_back(id);
+        }
+    }
+
+    [[nodiscard]] bool added_at(Entity id, std::uint64_t /*tick*/) const
+    {
+        return test(added_now_, id);
+    }
+
+    [[nodiscard]] bool changed_at(Entity id, std::uint64_t /*tick*/) const
+    {
+        return test(changed_now_, id);
+    }
+
+    void remove(Entity id) override
+    {
+        if (!contains(id)) {
+            return;
+        }
+        reset(present_, id);
+        reset(added_now_, id);
+        reset(changed_now_, id);
+        auto const slot = slots_[id];
+        ids_[slot] = ids_.back();
+        slots_[ids_[slot]] = slot;
+        ids_.pop_back();
+        removed_.push_back(id);
+    }
+
+    /// @brief Every entity with the component, in no particular order.
+    [[nodiscard]] std::span<Entity const> ids() const
     {
-        return entities_.at(id);
+        return ids_;
     }
 
-    void remove(Entity id)
+    [[nodiscard]] std::size_t size() const
     {
-        entities_.erase(id);
+        return ids_.size();
     }
 
-    std::unordered_map<Entity, T> const &entities() const
+    [[nodiscard]] std::span<Entity const> added() const
     {
-        return entities_;
+        return added_;
+    }
+
+    [[nodiscard]] std::span<Entity const> changed() const
+    {
+        return changed_;
+    }
+
+    [[nodiscard]] std::span<Entity const> removed() const
+    {
+        return removed_;
+    }
+
+    void clear_tick() override
+    {
+        for (auto id : added_) {
+            reset(added_now_, id);
+        }
+        for (auto id : changed_) {
+            reset(changed_now_, id);
+        }
+        added_.clear();
+        changed_.clear();
+        removed_.clear();
     }
 
   private:
-    std::unordered_map<Entity, T> entities_;
+    static constexpr std::size_t word_bits{64};
+
+    [[no_unique_address]] T value_{};
+    std::vector<std::uint64_t> present_;
+    std::vector<std::uint64_t> added_now_;   // Added during the current tick
+    std::vector<std::uint64_t> changed_now_; // Written during it
+    std::vector<Entity> ids_;
+    std::vector<std::uint32_t> slots_; // Index in ids_, by entity
+    std::vector<Entity> added_;
+    std::vector<Entity> changed_;
+    std::vector<Entity> removed_;
+
+    static bool test(std::vector<std::uint64_t> const &words, Entity id)
+    {
+        auto const w = id / word_bits;
+        return w < words.size() && ((words[w] >> (id % word_bits)) & 1U) != 0;
+    }
+
+    static void set(std::vector<std::uint64_t> &words, Entity id)
+    {
+        auto const w = id / word_bits;
+        if (w >= words.size()) {
+            words.resize(w + 1);
+        }
+        words[w] |= std::uint64_t{1} << (id % word_bits);
+    }
+
+    static void reset(std::vector<std::uint64_t> &words, Entity id)
+    {
+        auto const w = id / word_bits;
+        if (w < words.size()) {
+            words[w] &= ~(std::uint64_t{1} << (id % word_bits));
+        }
+    }
 };
 
+// The components of a World. Storages belong to the instance and are found by
+// component id, so several managers, in either Storage_mode, can coexist.
 class Component_manager {
   public:
+    template <typename First, typename... Rest> class View;
+
+    /// @brief Called with a batch of entities, see on_add().
+    using Hook = std::function<void(std::span<Entity const>)>;
+
+    explicit Component_manager(Storage_mode mode = Storage_mode::maps)
+        : mode_(mode)
+    {
+    }
+
+    [[nodiscard]] Storage_mode mode() const
+    {
+        return mode_;
+    }
+
     template <typename Component> void add(Entity id, Component comp)
     {
-        storage<Component>().add(id, std::move(comp));
+        if (mode_ == Storage_mode::maps) {
+            storage<Component>().add(id, std::move(comp), tick_);
+            return;
+        }
+        auto *slot = archetypes_.add(id, component_id<Component>(), tick_);
+        if constexpr (!std::is_empty_v<Component>) {
+            std::construct_at(static_cast<Component *>(slot), std::move(comp));
+        }
+    }
+
+    /// @brief Adds the same components to every entity of `ids`, which
+    /// must have none yet: those of entity `i` are the std::tuple returned
+    /// by `make(i)`. Storages are reserved for all of them up front, and in
+    /// Storage_mode::archetypes they're placed straight into their final
+    /// archetype, in consecutive rows, which only count once all of their
+    /// components are constructed.
+    template <typename... Components, typename Make>
+    void add_n(std::span<Entity const> ids, Make &&make)
+    {
+        if (mode_ == Storage_mode::maps) {
+            (storage<Components>().reserve(ids.size()), ...);
+            for (std::size_t i{}; i != ids.size(); ++i) {
+                std::tuple<Components...> components = make(i);
+                (storage<Components>().add(
+                     ids[i], std::move(std::get<Components>(components)),
+                     tick_),
+                 ...);
+            }
+            return;
+        }
+        auto const mask = bits<Components...>();
+        auto const [archetype, first] = archetypes_.reserve_n(ids, mask);
+        auto row = first;
+        Mask built{}; // Components of `row` constructed so far
+        try {
+            for (; row != first + ids.size(); ++row) {
+                built = 0;
+                std::tuple<Components...> components = make(row - first);
+                ((construct_at<Components>(
+                      archetype, row,
+                      std::move(std::get<Components>(components))),
+                  built |= bits<Components>()),
+                 ...);
+            }
+        }
+        catch (...) {
+            archetypes_.destroy(archetype, row, built);
+            for (auto r = first; r != row; ++r) {
+                archetypes_.destroy(archetype, r, mask);
+            }
+            throw;
+        }
+        archetypes_.commit_n(archetype, ids, tick_);
     }
 
     template <typename Component> Component &get(Entity id)
     {
-        return storage<Component>().get(id);
+        if (mode_ == Storage_mode::maps) {
+            return storage<Component>().get(id, tick_);
+        }
+        return as<Component>(
+            archetypes_.get(id, component_id<Component>(), tick_));
+    }
+
+    /// @brief Like get(), without counting as a write.
+    template <typename Component>
+    [[nodiscard]] Component const &read(Entity id) const
+    {
+        if (mode_ == Storage_mode::maps) {
+            auto const *s = find_storage<Component>();
+            if (s == nullptr) {
+                throw std::out_of_range(
+                    "entity doesn't contain that component");
+            }
+            return s->read(id);
+        }
+        return as<Component const>(
+            archetypes_.read(id, component_id<Component>()));
+    }
+
+    template <typename Component> [[nodiscard]] bool contains(Entity id) const
+    {
+        if (mode_ == Storage_mode::maps) {
+            auto const *s = find_storage<Component>();
+            return s != nullptr && s->contains(id);
+        }
+        return archetypes_.contains(id, component_id<Component>());
+    }
+
+    template <typename Component> void mark_changed(Entity id)
+    {
+        if (mode_ == Storage_mode::maps) {
+            storage<Component>().mark_changed(id, tick_);
+        }
+        else {
+            archetypes_.mark_changed(id, component_id<Component>(), tick_);
+        }
+    }
+
+    /// @brief Entities with Component, enabled or not, without visiting them.
+    template <typename Component> [[nodiscard]] std::size_t count() const
+    {
+        if (mode_ == Storage_mode::maps) {
+            auto const *s = find_storage<Component>();
+            return s != nullptr ? s->size() : 0;
+        }
+        std::size_t n{};
+        for (auto const &a : archetypes_.archetypes()) {
+            if ((a->mask() & bits<Component>()) != 0) {
+                n += a->size();
+            }
+        }
+        return n;
+    }
+
+    /// @brief Entities whose Component was removed during the current tick.
+    template <typename Component>
+    [[nodiscard]] std::span<Entity const> removed() const
+    {
+        if (mode_ == Storage_mode::maps) {
+            auto const *s = find_storage<Component>();
+            return s != nullptr ? s->removed() : std::span<Entity const>{};
+        }
+        return archetypes_.removed(component_id<Component>());
+    }
+
+    /// @brief Registers `hook` to be called at every advance_tick() with the
+    /// entities Component was added to during the tick, if any. Secondary
+    /// indices can be kept up to date this way instead of being rebuilt from
+    /// views. Hooks mustn't add or remove components.
+    template <typename Component> void on_add(Hook hook)
+    {
+        observer<Component>().on_add.push_back(std::move(hook));
+    }
+
+    /// @brief As on_add(), with the entities that had Component when the
+    /// tick began and were removed from during it. Entities that got and lost
+    /// it within the same tick are reported to neither; those that lost it and
+    /// got it back, to both.
+    template <typename Component> void on_remove(Hook hook)
+    {
+        observer<Component>().on_remove.push_back(std::move(hook));
     }
 
-    template <typename Component> [[nodiscard]] bool contains(Entity id)
+    /// @brief Tick that writes are stamped with, starting at 1.
+    [[nodiscard]] std::uint64_t tick() const
     {
-        return storage<Component>().contains(id);
+        return tick_;
     }
 
+    /// @brief Ends the tick with the structural flush, calling the on_add()
+    /// and on_remove() hooks, then starts the next one: the added, changed
+    /// and removed lists of every storage start over empty.
+    void advance_tick();
+
     void remove(Entity id);
 
-    template <typename First, typename... Rest> std::vector<Entity> eager_view()
+    /// @brief Disabled entities keep all their components, but views skip
+    /// them. Toggling this never touches the component storages.
+    void set_enabled(Entity id, bool enabled)
     {
-        std::vector<Entity> result;
-        auto const &base = storage<First>().entities();
-        for (auto &&[id, _] : base) {
-            if ((storage<Rest>().contains(id) && ...)) {
-                result.push_back(id);
+        if (id >= disabled_.size()) {
+            disabled_.resize(id + 1);
+        }
+        disabled_[id] = !enabled;
+    }
+
+    [[nodiscard]] bool is_enabled(Entity id) const
+    {
+        return id >= disabled_.size() || !disabled_[id];
+    }
+
+    /// @brief One step of an incremental sort: reorders the rows of the next
+    /// archetype holding Component, round-robin, by ascending `key(c)` of
+    /// their Component. A row moves as a whole, so an entity's components
+    /// keep sharing one index. There are no rows to reorder in
+    /// Storage_mode::maps; it does nothing then.
+    /// @return Whether rows moved, which invalidates component addresses
+    template <typename Component, typename Key> bool sort_step(Key &&key)
+    {
+        static_assert(!std::is_empty_v<Component>);
+        if (mode_ != Storage_mode::archetypes) {
+            return false;
+        }
+        auto const archetypes = archetypes_.archetypes();
+        auto const id = component_id<Component>();
+        for (std::size_t n{}; n != archetypes.size(); ++n) {
+            auto const i = next_sorted_++ % archetypes.size();
+            auto const &a = *archetypes[i];
+            if ((a.mask() & Archetype_storage::bit(id)) == 0 || a.size() < 2) {
+                continue;
             }
+            sort_keys_.clear();
+            for (std::size_t c{}; c != a.chunk_count(); ++c) {
+                auto const *column =
+                    static_cast<Component const *>(a.column(id, c));
+                for (std::size_t row{}; row != a.entities(c).size(); ++row) {
+                    sort_keys_.push_back(key(column[row]));
+                }
+            }
+            return archetypes_.sort_rows(i, sort_keys_);
+        }
+        return false;
+    }
+
+    template <typename First, typename... Rest>
+    std::pmr::vector<Entity>
+    eager_view(std::pmr::memory_resource *resource =
+                   std::pmr::get_default_resource()) const
+    {
+        std::pmr::vector<Entity> result(resource);
+        for (auto id : view<First, Rest...>()) {
+            result.push_back(id);
         }
         return result;
     }
 
-    template <typename First, typename... Rest> auto view()
+    /// @brief The enabled entities matching every query: a component type or
+    /// one of the filters above. Views led by a component type walk the
+    /// archetypes chunk by chunk in Storage_mode::archetypes, skipping whole
+    /// archetypes that can't match.
+    template <typename First, typename... Rest>
+    [[nodiscard]] View<First, Rest...> view() const
     {
-        auto const &base = storage<First>().entities() | std::views::keys;
-        auto filtered = base | std::views::filter([this](auto id) {
-                            return (storage<Rest>().contains(id) && ...);
-                        });
-        return filtered;
+        return View<First, Rest...>(*this);
     }
 
   private:
+    using Mask = Archetype_storage::Mask;
+
+    Storage_mode mode_;
+    std::vector<bool> disabled_;
+    std::uint64_t tick_{1};
+    // Storage_mode::maps, indexed by component id.
+    std::vector<std::unique_ptr<Component_storage_base>> storages_;
+    Archetype_storage archetypes_;
+    std::size_t next_sorted_{}; // See sort_step()
+    std::vector<std::uint64_t> sort_keys_;
+
+    struct Observer {
+        // Calls the hooks, knowing the component type.
+        void (*flush)(Component_manager &cm, Observer const &o){};
+        std::vector<Hook> on_add;
+        std::vector<Hook> on_remove;
+    };
+    std::vector<Observer> observers_; // Indexed by component id
+    std::vector<Entity> added_batch_;
+    std::vector<Entity> removed_batch_;
+    std::vector<Entity> sorted_added_; // Scratch of flush_observer()
+    std::vector<Entity> sorted_removed_;
+
+    template <typename Component> Observer &observer()
+    {
+        auto const id = component_id<Component>();
+        if (id >= observers_.size()) {
+            observers_.resize(id + 1);
+        }
+        auto &o = observers_[id];
+        o.flush = &flush_observer<Component>;
+        return o;
+    }
+
+    template <typename Component>
+    static void flush_observer(Component_manager &cm, Observer const &o)
+    {
+        auto &added = cm.added_batch_;
+        auto &removed = cm.removed_batch_;
+        added.clear();
+        removed.clear();
+        // An entity added again within the tick is listed once per add.
+        auto const listed =
+            cm.candidates(std::type_identity<Added<Component>>{});
+        auto &fresh = cm.sorted_added_;
+        fresh.assign(listed.begin(), listed.end());
+        std::ranges::sort(fresh);
+        for (auto it = fresh.begin(); it != fresh.end();
+             it = std::ranges::upper_bound(it, fresh.end(), *it)) {
+            if (cm.matches<Added<Component>>(*it)) {
+                added.push_back(*it);
+            }
+        }
+        auto const gone = cm.removed<Component>();
+        if (!o.on_remove.empty() && !gone.empty()) {
+            // An entity's adds and removals within a tick alternate, so it had
+            // Component when the tick began iff it has it now plus its
+            // removals minus its adds is one.
+            auto &lost = cm.sorted_removed_;
+            lost.assign(gone.begin(), gone.end());
+            std::ranges::sort(lost);
+            for (auto it = lost.begin(); it != lost.end();) {
+                auto const id = *it;
+                auto const next = std::ranges::upper_bound(it, lost.end(), id);
+                auto const removals = next - it;
+                auto const adds =
+                    std::ranges::distance(std::ranges::equal_range(fresh, id));
+                auto const has = cm.contains<Component>(id) ? 1 : 0;
+                if (has + removals - adds == 1) {
+                    removed.push_back(id);
+                }
+                it = next;
+            }
+        }
+        if (!added.empty()) {
+            for (auto const &hook : o.on_add) {
+                hook(added);
+            }
+        }
+        if (!removed.empty()) {
+            for (auto const &hook : o.on_remove) {
+                hook(removed);
+            }
+        }
+    }
+
     template <typename Component> Component_storage<Component> &storage()
     {
-        static Component_storage<Component> storage;
-        return storage;
+        auto const id = component_id<Component>();
+        if (id >= storages_.size()) {
+            storages_.resize(id + 1);
+        }
+        auto &s = storages_[id];
+        if (!s) {
+            s = std::make_unique<Component_storage<Component>>();
+        }
+        return static_cast<Component_storage<Component> &>(*s);
+    }
+
+    template <typename Component>
+    [[nodiscard]] Component_storage<Component> const *find_storage() const
+    {
+        auto const id = component_id<Component>();
+        return id < storages_.size()
+                   ? static_cast<Component_storage<Component> const *>(
+                         storages_[id].get())
+                   : nullptr;
+    }
+
+    // Empty components aren't stored by Archetype_storage; any instance will
+    // do.
+    template <typename Component> static Component &as(auto *p)
+    {
+        if constexpr (std::is_empty_v<Component>) {
+            static std::remove_const_t<Component> empty;
+            return empty;
+        }
+        else {
+            return *static_cast<Component *>(p);
+        }
+    }
+
+    template <typename Component>
+    void construct_at(std::size_t archetype, std::size_t row, Component &&c)
+    {
+        if constexpr (!std::is_empty_v<std::remove_cvref_t<Component>>) {
+            std::construct_at(
+                static_cast<std::remove_cvref_t<Component> *>(
+                    archetypes_.data(archetype,
+                                     component_id<std::remove_cvref_t<
+                                         Component>>(),
+                                     row)),
+                std::forward<Component>(c));
+        }
+    }
+
+    template <typename... Components> static Mask bits()
+    {
+        return (Mask{} | ... |
+                Archetype_storage::bit(component_id<Components>()));
+    }
+
+    // The entities a view led by `Query` starts from, unless it walks the
+    // archetypes.
+    template <typename T>
+    [[nodiscard]] std::span<Entity const>
+    candidates(std::type_identity<T> /*unused*/) const
+    {
+        auto const *s = find_storage<T>();
+        return s != nullptr ? s->ids() : std::span<Entity const>{};
+    }
+
+    template <typename T>
+    [[nodiscard]] std::span<Entity const>
+    candidates(std::type_identity<Changed<T>> /*unused*/) const
+    {
+        if (mode_ == Storage_mode::archetypes) {
+            return archetypes_.changed(component_id<T>());
+        }
+        auto const *s = find_storage<T>();
+        return s != nullptr ? s->changed() : std::span<Entity const>{};
+    }
+
+    template <typename T>
+    [[nodiscard]] std::span<Entity const>
+    candidates(std::type_identity<Added<T>> /*unused*/) const
+    {
+        if (mode_ == Storage_mode::archetypes) {
+            return archetypes_.added(component_id<T>());
+        }
+        auto const *s = find_storage<T>();
+        return s != nullptr ? s->added() : std::span<Entity const>{};
+    }
+
+    template <typename... Ts>
+    static void candidates(std::type_identity<Without<Ts...>> /*unused*/)
+    {
+        static_assert(false && sizeof...(Ts), "Without can't lead a view");
+    }
+
+    template <typename... Ts>
+    static void candidates(std::type_identity<Any_of<Ts...>> /*unused*/)
+    {
+        static_assert(false && sizeof...(Ts), "Any_of can't lead a view");
+    }
+
+    // Whether an entity matches a query, probing the storages.
+    template <typename Query> [[nodiscard]] bool matches(Entity id) const
+    {
+        return matches(id, std::type_identity<Query>{});
+    }
+
+    template <typename T>
+    [[nodiscard]] bool matches(Entity id,
+                               std::type_identity<T> /*unused*/) const
+    {
+        return contains<T>(id);
+    }
+
+    template <typename T>
+    [[nodiscard]] bool
+    matches(Entity id, std::type_identity<Changed<T>> /*unused*/) const
+    {
+        if (mode_ == Storage_mode::archetypes) {
+            return archetypes_.changed_at(id, component_id<T>(), tick_);
+        }
+        auto const *s = find_storage<T>();
+        return s != nullptr && s->changed_at(id, tick_);
+    }
+
+    template <typename T>
+    [[nodiscard]] bool matches(Entity id,
+                               std::type_identity<Added<T>> /*unused*/) const
+    {
+        if (mode_ == Storage_mode::archetypes) {
+            return archetypes_.added_at(id, component_id<T>(), tick_);
+        }
+        auto const *s = find_storage<T>();
+        return s != nullptr && s->added_at(id, tick_);
+    }
+
+    template <typename... Ts>
+    [[nodiscard]] bool
+    matches(Entity id, std::type_identity<Without<Ts...>> /*unused*/) const
+    {
+        return !(contains<Ts>(id) || ...);
+    }
+
+    template <typename... Ts>
+    [[nodiscard]] bool
+    matches(Entity id, std::type_identity<Any_of<Ts...>> /*unused*/) const
+    {
+        return (contains<Ts>(id) || ...);
+    }
+
+    // Whether an archetype can hold entities matching a query. Only the tick
+    // filters are left to check per entity then.
+    template <typename T>
+    static bool admits(Mask mask, std::type_identity<T> /*unused*/)
+    {
+        return (mask & bits<T>()) != 0;
+    }
+
+    template <typename T>
+    static bool admits(Mask mask, std::type_identity<Changed<T>> /*unused*/)
+    {
+        return (mask & bits<T>()) != 0;
+    }
+
+    template <typename T>
+    static bool admits(Mask mask, std::type_identity<Added<T>> /*unused*/)
+    {
+        return (mask & bits<T>()) != 0;
+    }
+
+    template <typename... Ts>
+    static bool admits(Mask mask,
+                       std::type_identity<Without<Ts...>> /*unused*/)
+    {
+        return (mask & bits<Ts...>()) == 0;
+    }
+
+    template <typename... Ts>
+    static bool admits(Mask mask,
+                       std::type_identity<Any_of<Ts...>> /*unused*/)
+    {
+        return (mask & bits<Ts...>()) != 0;
+    }
+
+    template <typename Query>
+    [[nodiscard]] bool matches_tick(Entity id) const
+    {
+        return matches_tick(id, std::type_identity<Query>{});
+    }
+
+    template <typename Query>
+    [[nodiscard]] bool matches_tick(Entity /*id*/,
+                                    std::type_identity<Query> /*unused*/) const
+    {
+        return true;
+    }
+
+    template <typename T>
+    [[nodiscard]] bool
+    matches_tick(Entity id, std::type_identity<Changed<T>> query) const
+    {
+        return matches(id, query);
+    }
+
+    template <typename T>
+    [[nodiscard]] bool
+    matches_tick(Entity id, std::type_identity<Added<T>> query) const
+    {
+        return matches(id, query);
+    }
+};
+
+// A forward range over the entities of Component_manager::view(). Walks either
+// one list of candidates, checking every query per entity, or the chunks of the
+// archetypes admitting every query, checking only enabled-ness and the tick
+// filters per entity.
+template <typename First, typename... Rest>
+class Component_manager::View {
+  public:
+    class iterator {
+      public:
+        using value_type = Entity;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        Entity operator*() const
+        {
+            return ids_[row_];
+        }
+
+        iterator &operator++()
+        {
+            ++row_;
+            settle();
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(iterator const &rhs) const
+        {
+            return segment_ == rhs.segment_ && chunk_ == rhs.chunk_ &&
+                   row_ == rhs.row_;
+        }
+
+        bool operator==(std::default_sentinel_t /*unused*/) const
+        {
+            return segment_ == view_->segments_;
+        }
+
+      private:
+        friend class View;
+
+        View const *view_{};
+        // The archetype walked, or 0 for the list; segments_ once done.
+        std::size_t segment_{};
+        std::size_t chunk_{};
+        std::size_t row_{};
+        std::span<Entity const> ids_;
+
+        explicit iterator(View const &view) : view_(&view)
+        {
+            if (view.by_archetype_) {
+                enter(0, 0);
+            }
+            else {
+                ids_ = view.list_;
+            }
+            settle();
+        }
+
+        // Moves to the first non-empty chunk of an admitted archetype from
+        // chunk `chunk` of archetype `segment` on.
+        void enter(std::size_t segment, std::size_t chunk)
+        {
+            auto const archetypes = view_->cm_->archetypes_.archetypes();
+            for (; segment != archetypes.size(); ++segment, chunk = 0) {
+                auto const &a = *archetypes[segment];
+                if (chunk < a.chunk_count() && View::admits(a.mask())) {
+                    segment_ = segment;
+                    chunk_ = chunk;
+                    row_ = 0;
+                    ids_ = a.entities(chunk);
+                    return;
+                }
+            }
+            finish();
+        }
+
+        void finish()
+        {
+            segment_ = view_->segments_;
+            chunk_ = 0;
+            row_ = 0;
+            ids_ = {};
+        }
+
+        void settle()
+        {
+            while (segment_ != view_->segments_) {
+                for (; row_ != ids_.size(); ++row_) {
+                    if (view_->accepts(ids_[row_])) {
+                        return;
+                    }
+                }
+                if (view_->by_archetype_) {
+                    enter(segment_, chunk_ + 1);
+                }
+                else {
+                    finish();
+                }
+            }
+        }
+    };
+
+    explicit View(Component_manager const &cm)
+        : cm_(&cm),
+          by_archetype_(cm.mode_ == Storage_mode::archetypes &&
+                        leads_by_type),
+          segments_(by_archetype_ ? cm.archetypes_.archetypes().size() : 1)
+    {
+        if (!by_archetype_) {
+            list_ = cm.candidates(std::type_identity<First>{});
+        }
+    }
+
+    [[nodiscard]] iterator begin() const
+    {
+        return iterator(*this);
+    }
+
+    [[nodiscard]] std::default_sentinel_t end() const
+    {
+        return {};
+    }
+
+  private:
+    static constexpr bool leads_by_type = !is_tick_filter_v<First>;
+
+    Component_manager const *cm_;
+    bool by_archetype_;
+    std::size_t segments_;
+    std::span<Entity const> list_;
+
+    static bool admits(Mask mask)
+    {
+        return Component_manager::admits(mask, std::type_identity<First>{}) &&
+               (Component_manager::admits(mask, std::type_identity<Rest>{}) &&
+                ...);
+    }
+
+    [[nodiscard]] bool accepts(Entity id) const
+    {
+        if (!cm_->is_enabled(id)) {
+            return false;
+        }
+        if (by_archetype_) {
+            return cm_->matches_tick<First>(id) &&
+                   (cm_->matches_tick<Rest>(id) && ...);
+        }
+        return cm_->matches_tick<First>(id) && (cm_->matches<Rest>(id) && ...);
     }
 };
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <numbers>
 
 class Mesh;
 
@@ -15,7 +18,51 @@ struct Transform {
     glm::vec3 position = glm::vec3{};
     float yaw = 0;
     glm::vec3 scale = glm::vec3{1};
+
+    /// @brief Unit vector the entity faces, (cos yaw, 0, -sin yaw). Only
+    /// recomputed when yaw changed since the last call.
+    [[nodiscard]] glm::vec3 heading() const
+    {
+        if (yaw != heading_yaw_) {
+            heading_ = {std::cos(yaw), 0, -std::sin(yaw)};
+            heading_yaw_ = yaw;
+        }
+        return heading_;
+    }
+
+    /// @brief Sets yaw together with its known heading, skipping the
+    /// recomputation.
+    void set_heading(float new_yaw, glm::vec3 heading)
+    {
+        yaw = new_yaw;
+        heading_ = heading;
+        heading_yaw_ = new_yaw;
+    }
+
+    /// @brief Mirrors the heading off a face perpendicular to the x axis.
+    void reflect_x()
+    {
+        auto const h = heading();
+        set_heading((3 * std::numbers::pi_v<float>) - yaw, {-h.x, 0, h.z});
+    }
+
+    /// @brief Mirrors the heading off a face perpendicular to the z axis.
+    void reflect_z()
+    {
+        auto const h = heading();
+        set_heading((2 * std::numbers::pi_v<float>) - yaw, {h.x, 0, -h.z});
+    }
+
+    // Cache of heading(), valid while heading_yaw_ == yaw. Public only to
+    // keep Transform an aggregate.
+    mutable glm::vec3 heading_{1, 0, 0};
+    mutable float heading_yaw_{0};
+};
+// Model matrix of a Transform, kept up to date by systems::Transform_system.
+struct World_matrix {
+    glm::mat4 model{1};
 };
+
 struct Velocity {
     float linear;
     float angular;
@@ -30,12 +77,12 @@ namespace components {
 struct Weapon {
     float fire_rate;
     float bullet_speed;
-    float cooldown;
+    bool ready; // False while cooling down, set again by a timer.
     bool active;
 };
 
 struct Expirable {
-    float remaining_time;
+    std::uint64_t deadline; // In World ticks, see World::deadline_after.
 };
 
 } // namespace components
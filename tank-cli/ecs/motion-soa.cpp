@@ -0,0 +1,211 @@
+#include <cmath>
+#include <tank-cli/ecs/component-manager.hpp>
+#include <tank-cli/ecs/motion-soa.hpp>
+#ifdef TANK_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#ifdef TANK_AVX2
+
+// sin and cos of 8 floats at once, after Cephes' sinf/cosf: reduce x by a
+// multiple of pi/4 (in three parts, for precision), evaluate both minimax
+// polynomials on [-pi/4, pi/4], then pick and sign them by octant. Accurate to
+// a few ulp for |x| up to ~8192.
+void sincos8(__m256 x, __m256 &s, __m256 &c)
+{
+    auto const sign_mask = _mm256_set1_ps(-0.0F);
+    auto const one = _mm256_set1_epi32(1);
+    auto const two = _mm256_set1_epi32(2);
+    auto const four = _mm256_set1_epi32(4);
+
+    auto sin_sign = _mm256_and_ps(x, sign_mask);
+    x = _mm256_andnot_ps(sign_mask, x);
+
+    // Octant, rounded up to even.
+    auto j = _mm256_cvttps_epi32(
+        _mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516F))); // 4 / pi
+    j = _mm256_and_si256(_mm256_add_epi32(j, one), _mm256_set1_epi32(~1));
+    auto const y = _mm256_cvtepi32_ps(j);
+
+    sin_sign = _mm256_xor_ps(
+        sin_sign,
+        _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, four), 29)));
+    auto const cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_andnot_si256(_mm256_sub_epi32(j, two), four), 29));
+    // Octants where sin comes from the sin polynomial (and cos from cos).
+    auto const straight = _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(_mm256_and_si256(j, two), _mm256_setzero_si256()));
+
+    x = _mm256_fnmadd_ps(y, _mm256_set1_ps(0.78515625F), x);
+    x = _mm256_fnmadd_ps(y, _mm256_set1_ps(2.4187564849853515625e-4F), x);
+    x = _mm256_fnmadd_ps(y, _mm256_set1_ps(3.77489497744594108e-8F), x);
+    auto const z = _mm256_mul_ps(x, x);
+
+    auto p_cos = _mm256_set1_ps(2.443315711809948e-5F);
+    p_cos = _mm256_fmadd_ps(p_cos, z, _mm256_set1_ps(-1.388731625493765e-3F));
+    p_cos = _mm256_fmadd_ps(p_cos, z, _mm256_set1_ps(4.166664568298827e-2F));
+    p_cos = _mm256_mul_ps(_mm256_mul_ps(p_cos, z), z);
+    p_cos = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5F), p_cos);
+    p_cos = _mm256_add_ps(p_cos, _mm256_set1_ps(1));
+
+    auto p_sin = _mm256_set1_ps(-1.9515295891e-4F);
+    p_sin = _mm256_fmadd_ps(p_sin, z, _mm256_set1_ps(8.3321608736e-3F));
+    p_sin = _mm256_fmadd_ps(p_sin, z, _mm256_set1_ps(-1.6666654611e-1F));
+    p_sin = _mm256_fmadd_ps(_mm256_mul_ps(p_sin, z), x, x);
+
+    s = _mm256_xor_ps(_mm256_blendv_ps(p_cos, p_sin, straight), sin_sign);
+    c = _mm256_xor_ps(_mm256_blendv_ps(p_sin, p_cos, straight), cos_sign);
+}
+
+#endif
+
+} // namespace
+
+void Motion_soa::add(Entity id, Transform &t, Velocity const &v)
+{
+    if (rows_.contains(id)) {
+        remove(id);
+    }
+    auto const heading = t.heading();
+    rows_[id] = ids_.size();
+    x_.push_back(t.position.x);
+    z_.push_back(t.position.z);
+    yaw_.push_back(t.yaw);
+    heading_x_.push_back(heading.x);
+    heading_z_.push_back(heading.z);
+    linear_.push_back(v.linear);
+    angular_.push_back(v.angular);
+    next_x_.push_back(t.position.x);
+    next_z_.push_back(t.position.z);
+    transforms_.push_back(&t);
+    ids_.push_back(id);
+    turning_ += v.angular != 0 ? 1 : 0;
+}
+
+void Motion_soa::remove(Entity id)
+{
+    auto it = rows_.find(id);
+    if (it == rows_.end()) {
+        return;
+    }
+    auto const i = it->second;
+    rows_.erase(it);
+    turning_ -= angular_[i] != 0 ? 1 : 0;
+
+    auto const last = ids_.size() - 1;
+    if (i != last) {
+        x_[i] = x_[last];
+        z_[i] = z_[last];
+        yaw_[i] = yaw_[last];
+        heading_x_[i] = heading_x_[last];
+        heading_z_[i] = heading_z_[last];
+        linear_[i] = linear_[last];
+        angular_[i] = angular_[last];
+        next_x_[i] = next_x_[last];
+        next_z_[i] = next_z_[last];
+        transforms_[i] = transforms_[last];
+        ids_[i] = ids_[last];
+        rows_[ids_[i]] = i;
+    }
+    x_.pop_back();
+    z_.pop_back();
+    yaw_.pop_back();
+    heading_x_.pop_back();
+    heading_z_.pop_back();
+    linear_.pop_back();
+    angular_.pop_back();
+    next_x_.pop_back();
+    next_z_.pop_back();
+    transforms_.pop_back();
+    ids_.pop_back();
+}
+
+void Motion_soa::load(std::size_t i)
+{
+    auto const &t = *transforms_[i];
+    auto const heading = t.heading();
+    x_[i] = t.position.x;
+    z_[i] = t.position.z;
+    yaw_[i] = t.yaw;
+    heading_x_[i] = heading.x;
+    heading_z_[i] = heading.z;
+}
+
+void Motion_soa::rebind(Component_manager &cm)
+{
+    for (std::size_t i{}; i != ids_.size(); ++i) {
+        transforms_[i] = &cm.get<Transform>(ids_[i]);
+    }
+}
+
+Transform &Motion_soa::transform(std::size_t i)
+{
+    write_back(i);
+    return *transforms_[i];
+}
+
+void Motion_soa::write_back(std::size_t i)
+{
+    auto &t = *transforms_[i];
+    t.position.x = x_[i];
+    t.position.z = z_[i];
+    t.set_heading(yaw_[i], {heading_x_[i], 0, heading_z_[i]});
+}
+
+void Motion_soa::integrate(float dt)
+{
+    auto const n = size();
+    std::size_t i{};
+#ifdef TANK_AVX2
+    auto const vdt = _mm256_set1_ps(dt);
+    for (; i + 8 <= n; i += 8) {
+        auto const d = _mm256_mul_ps(_mm256_loadu_ps(&linear_[i]), vdt);
+        _mm256_storeu_ps(&next_x_[i],
+                         _mm256_fmadd_ps(_mm256_loadu_ps(&heading_x_[i]), d,
+                                         _mm256_loadu_ps(&x_[i])));
+        _mm256_storeu_ps(&next_z_[i],
+                         _mm256_fmadd_ps(_mm256_loadu_ps(&heading_z_[i]), d,
+                                         _mm256_loadu_ps(&z_[i])));
+    }
+#endif
+    for (; i != n; ++i) {
+        auto const d = linear_[i] * dt;
+        next_x_[i] = std::fma(heading_x_[i], d, x_[i]);
+        next_z_[i] = std::fma(heading_z_[i], d, z_[i]);
+    }
+}
+
+// Headings as in Transform::heading: (cos yaw, -sin yaw) on the xz plane.
+void Motion_soa::turn_and_write_back(float dt)
+{
+    auto const n = size();
+    if (turning_ != 0) {
+        std::size_t i{};
+#ifdef TANK_AVX2
+        auto const vdt = _mm256_set1_ps(dt);
+        for (; i + 8 <= n; i += 8) {
+            auto const yaw = _mm256_fmadd_ps(_mm256_loadu_ps(&angular_[i]),
+                                             vdt, _mm256_loadu_ps(&yaw_[i]));
+            __m256 s;
+            __m256 c;
+            sincos8(yaw, s, c);
+            _mm256_storeu_ps(&yaw_[i], yaw);
+            _mm256_storeu_ps(&heading_x_[i], c);
+            _mm256_storeu_ps(&heading_z_[i],
+                             _mm256_xor_ps(s, _mm256_set1_ps(-0.0F)));
+        }
+#endif
+        for (; i != n; ++i) {
+            if (angular_[i] != 0) {
+                yaw_[i] += angular_[i] * dt;
+                heading_x_[i] = std::cos(yaw_[i]);
+                heading_z_[i] = -std::sin(yaw_[i]);
+            }
+        }
+    }
+    for (std::size_t i{}; i != n; ++i) {
+        write_back(i);
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <tank-cli/ecs/components.hpp>
+#include <tank-cli/ecs/entity.hpp>
+#include <unordered_map>
+#include <vector>
+
+class Component_manager;
+
+// Motion state of the entities that opted in, as a struct of arrays: one array
+// per field, one row per entity. Every row carries its heading, so moving it is
+// one FMA per axis over contiguous floats, 8 rows at a time with AVX2 (xmake f
+// --avx2=y), otherwise one at a time. Headings are only recomputed (with a
+// vectorized sincos) while some row is turning.
+//
+// The rows are the authority on where those entities are while they're in
+// here; write_back() copies them into the Transform components. The Transform
+// pointers stay valid because pooled entities never change their set of
+// components after Bullet_pool::grow, nor are they erased: map storages are
+// node-based, and archetype rows only move on such structural changes, or when
+// sorted, after which rebind() is due.
+class Motion_soa {
+  public:
+    /// @brief Adds a row for `id`, initialized from its components.
+    void add(Entity id, Transform &t, Velocity const &v);
+
+    /// @brief Swap-removes the row of `id`, if it has one.
+    void remove(Entity id);
+
+    /// @brief Reloads row `i` from its Transform, after it was moved outside
+    /// of the kernels.
+    void load(std::size_t i);
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return ids_.size();
+    }
+
+    /// @brief Computes next_x()/next_z(): each row moved `linear * dt` along
+    /// its heading.
+    void integrate(float dt);
+
+    /// @brief Accepts the next position of row `i`.
+    void commit(std::size_t i)
+    {
+        x_[i] = next_x_[i];
+        z_[i] = next_z_[i];
+    }
+
+    /// @brief Applies the angular velocities, then copies every row into its
+    /// Transform, heading included.
+    void turn_and_write_back(float dt);
+
+    [[nodiscard]] std::span<float const> x() const
+    {
+        return x_;
+    }
+
+    [[nodiscard]] std::span<float const> z() const
+    {
+        return z_;
+    }
+
+    [[nodiscard]] std::span<float const> next_x() const
+    {
+        return next_x_;
+    }
+
+    [[nodiscard]] std::span<float const> next_z() const
+    {
+        return next_z_;
+    }
+
+    [[nodiscard]] std::span<float const> linear() const
+    {
+        return linear_;
+    }
+
+    /// @brief Fetches the Transform of every row again, after they moved in
+    /// storage (see Component_manager::sort_step).
+    void rebind(Component_manager &cm);
+
+    /// @brief The entity of every row.
+    [[nodiscard]] std::span<Entity const> ids() const
+    {
+        return ids_;
+    }
+
+    /// @brief The Transform row `i` writes back to, with the position and
+    /// heading of the row.
+    [[nodiscard]] Transform &transform(std::size_t i);
+
+  private:
+    std::vector<float> x_;
+    std::vector<float> z_;
+    std::vector<float> yaw_;
+    std::vector<float> heading_x_;
+    std::vector<float> heading_z_;
+    std::vector<float> linear_;
+    std::vector<float> angular_;
+    std::vector<float> next_x_;
+    std::vector<float> next_z_;
+    std::vector<Transform *> transforms_;
+    std::vector<Entity> ids_;
+    std::unordered_map<Entity, std::size_t> rows_;
+    std::size_t turning_{}; // Rows with a nonzero angular velocity
+
+    void write_back(std::size_t i);
+};
@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
 #include <random>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
 #include <tank-cli/ecs/bundles.hpp>
 #include <tank-cli/ecs/components.hpp>
 #include <tank-cli/ecs/entity-manager.hpp>
@@ -20,144 +24,253 @@ auto systems::util::rand()
     return ret;
 }
 
-void systems::Physics::update(Entity_manager &em, Component_manager &cm,
-                              float dt, ::Map const &map)
+namespace {
+
+// Moves the bullet `distance` along its heading. Walls are found by sweeping
+// the segment through the map grid, so fast bullets can't tunnel through thin
+// walls. On a hit the bullet stops just before the wall face, reflects and
+// travels the remaining distance.
+void move_bullet(Transform &t, float distance, ::Map const &map)
 {
-    for (Entity id : cm.view<Transform, Velocity>()) {
-        auto &t = cm.get<Transform>(id);
-        auto &v = cm.get<Velocity>(id);
-        // For tanks
-        if (cm.contains<Tank_tag>(id)) {
-            auto dest = t.position + util::yaw2vec(t.yaw) * v.linear * dt;
-            if (map.is_visitable(dest, false)) {
-                t.position = dest;
-            }
+    constexpr int max_bounces = 4;
+    constexpr float skin = 1e-3F; // Keeps the bullet out of the wall cell
+
+    for (int i{}; i != max_bounces && distance > 0; ++i) {
+        auto dir = t.heading();
+        auto dest = t.position + dir * distance;
+        auto hit = map.raycast({t.position.x, t.position.z}, {dest.x, dest.z});
+        if (!hit) {
+            t.position = dest;
+            return;
+        }
+
+        auto travelled = distance * hit->t;
+        t.position += dir * std::max(travelled - skin, 0.F);
+        distance -= travelled;
+        if (hit->x_face) {
+            t.reflect_x();
         }
         else {
-            t.position += util::yaw2vec(t.yaw) * v.linear * dt;
+            t.reflect_z();
         }
-        t.yaw += v.angular * dt;
     }
+}
 
-    // Collision detection
-    // Bullet collide with wall
-    for (auto id : cm.view<Bullet_tag>()) {
+} // namespace
+
+void systems::Physics::update(World &w, float dt, ::Map &map)
+{
+    auto &cm = w.cm();
+    // Stationary entities are skipped to leave their Transform unwritten,
+    // see Transform_system.
+    for (Entity id : cm.view<Tank_tag, Transform, Velocity>()) {
+        auto const &v = cm.read<Velocity>(id);
+        if (v.linear == 0 && v.angular == 0) {
+            continue;
+        }
         auto &t = cm.get<Transform>(id);
-        auto &v = cm.get<Velocity>(id);
-        bool is_x_axis;
-        if (!map.is_visitable(t.position, true, &is_x_axis)) {
-            if (is_x_axis) {
-                t.yaw = 2 * std::numbers::pi - t.yaw;
-            }
-            else {
-                t.yaw = 3 * std::numbers::pi - t.yaw;
+        auto dest = t.position + (t.heading() * v.linear * dt);
+        if (map.is_visitable(dest, false)) {
+            auto const from = ::Map::cell_of(t.position);
+            auto const to = ::Map::cell_of(dest);
+            if (from != to) {
+                map.vacate(from);
+                map.occupy(to);
             }
+            t.position = dest;
         }
+        t.yaw += v.angular * dt;
+    }
+    for (Entity id :
+         cm.view<Velocity, Transform, Without<Tank_tag, Bullet_tag>>()) {
+        auto const &v = cm.read<Velocity>(id);
+        if (v.linear == 0 && v.angular == 0) {
+            continue;
+        }
+        auto &t = cm.get<Transform>(id);
+        t.position += t.heading() * v.linear * dt;
+        t.yaw += v.angular * dt;
     }
 
+    // Bullets are integrated together from the pool's motion rows, then swept
+    // through the map in one batch. Only those hitting a wall take the scalar
+    // path, to bounce.
+    auto &motion = w.bullet_pool().motion();
+    motion.integrate(dt);
+    std::pmr::vector<Segment> segments(&w.frame_arena());
+    segments.reserve(motion.size());
+    for (std::size_t i{}; i != motion.size(); ++i) {
+        segments.push_back({.from = {motion.x()[i], motion.z()[i]},
+                            .to = {motion.next_x()[i], motion.next_z()[i]}});
+    }
+    std::pmr::vector<std::optional<Ray_hit>> hits(motion.size(),
+                                                  &w.frame_arena());
+    map.raycast(segments, hits);
+    for (std::size_t i{}; i != motion.size(); ++i) {
+        if (!hits[i]) {
+            motion.commit(i);
+            continue;
+        }
+        move_bullet(motion.transform(i), motion.linear()[i] * dt, map);
+        motion.load(i);
+    }
+    motion.turn_and_write_back(dt);
+    for (auto id : motion.ids()) {
+        cm.mark_changed<Transform>(id);
+    }
+
+    // Collision detection
     // Collision between bullet and tank
-    std::vector<Entity> to_remove;
+    std::pmr::vector<Entity> to_remove(&w.frame_arena());
     for (auto id : cm.view<Bullet_tag>()) {
-        auto &t = cm.get<Transform>(id);
+        auto const &t = cm.read<Transform>(id);
 
         auto tanks = cm.view<Tank_tag>();
-        auto it = std::ranges::find_if(tanks, [&cm, t](auto tank) {
-            return glm::length(cm.get<Transform>(tank).position - t.position) <=
-                   1.5F; // Tank radius
+        auto it = std::ranges::find_if(tanks, [&cm, &t](auto tank) {
+            auto const &tank_pos = cm.read<Transform>(tank).position;
+            return glm::length(tank_pos - t.position) <= 1.5F; // Tank radius
         });
         if (it != tanks.end()) {
             to_remove.push_back(*it);
             to_remove.push_back(id);
         }
     }
+    // A tank hit by several bullets is listed once per bullet.
+    std::ranges::sort(to_remove);
+    auto const duplicates = std::ranges::unique(to_remove);
+    to_remove.erase(duplicates.begin(), duplicates.end());
     for (auto id : to_remove) {
-        cm.remove(id);
+        if (cm.contains<Bullet_tag>(id)) {
+            w.bullet_pool().release(cm, id);
+        }
+        else {
+            map.vacate(::Map::cell_of(cm.read<Transform>(id).position));
+            cm.remove(id);
+        }
     }
 }
 
 void systems::Spawner::update(World &w, ::Map &map)
 {
     int const desired_bot_count = 5;
-    int current_bot_count =
-        static_cast<int>(std::ranges::distance(w.cm().view<Bot_tag>()));
+    auto const current_bot_count = static_cast<int>(w.bot_count());
 
     spdlog::trace(
         "systems::Spawner desired_bot_count: {}, current_bot_count: {}",
         desired_bot_count, current_bot_count);
 
-    for (int i = 0; i < desired_bot_count - current_bot_count; ++i) {
-        spawn_tank(w, map, Bot_tag{});
+    if (current_bot_count < desired_bot_count) {
+        spawn_tanks(w, map, Bot_tag{},
+                    static_cast<std::size_t>(desired_bot_count -
+                                             current_bot_count));
     }
 
-    while (w.cm().eager_view<Player_tag>().size() < 2) {
-        spawn_tank(w, map, Player_tag{});
-        spawn_tank(w, map, Player_tag{});
+    auto const player_count = w.cm().count<Player_tag>();
+    if (player_count < 2) {
+        spawn_tanks(w, map, Player_tag{}, 2 - player_count);
     }
 }
 
 template <typename Tag>
-Entity systems::Spawner::spawn_tank(World &w, ::Map &map, Tag player_or_bot_tag,
-                                    Transform t, Velocity v,
-                                    components::Weapon weapon)
+std::size_t systems::Spawner::spawn_tanks(World &w, ::Map &map,
+                                          Tag player_or_bot_tag,
+                                          std::size_t count)
 {
-    Entity id = w.em().make();
-    w.cm().add(id, Tank_tag{});
-    w.cm().add(id, player_or_bot_tag);
-    w.cm().add(id, t);
-    w.cm().add(id, v);
-    w.cm().add(id, weapon);
-    w.cm().add(id, Renderable{.mesh = &systems::Resources::tank()});
-    return id;
-}
+    // The whole wave is drawn at once, from the free cells of the largest
+    // component, so no two tanks share a cell and all can reach each other.
+    auto const cells = map.take_free_cells(count, util::rand);
+    if (cells.size() != count) {
+        spdlog::warn("systems::Spawner room for {} of {} tanks", cells.size(),
+                     count);
+    }
 
-template <typename Tag>
-Entity systems::Spawner::spawn_tank(World &w, ::Map &map, Tag player_or_bot_tag)
-{
-    // Generate a visitable position to place the tank.
-    glm::vec3 position;
-    do {
-        position = {util::rand() % map.width(), 0.0F,
-                    util::rand() % map.height()};
-    } while (!map.is_visitable(position));
-
-    return spawn_tank(
-        w, map, player_or_bot_tag,
-        Transform{.position = position, .yaw = 0, .scale = glm::vec3{0.15F}},
+    Tank_bundle<Tag> const prefab(
+        Tank_tag{}, player_or_bot_tag,
+        Transform{.position = {}, .yaw = 0, .scale = glm::vec3{0.15F}},
         Velocity{.linear = 0, .angular = 0},
         components::Weapon{.fire_rate = 0.5F,
                            .bullet_speed = 16,
-                           .cooldown = 0,
-                           .active = false});
+                           .ready = true,
+                           .active = false},
+        Renderable{.mesh = &systems::Resources::tank()});
+    spawn_n<Tank_bundle<Tag>>(w.em(), w.cm(), cells.size(), [&](auto i) {
+        auto tank = prefab;
+        tank.template get<Transform>().position = {
+            static_cast<float>(cells[i].x) + 0.5F, 0.0F,
+            static_cast<float>(cells[i].y) + 0.5F};
+        return tank;
+    });
+    return cells.size();
 }
 
 Entity systems::Spawner::spawn_bullet(World &w, Transform t, Velocity v,
-                                      Renderable r, components::Expirable e)
+                                      Renderable r, float lifetime)
 {
-    auto bullet = w.em().make();
-    w.cm().add(bullet, Bullet_tag{});
-    w.cm().add(bullet, t);
-    w.cm().add(bullet, v);
-    w.cm().add(bullet, r);
-    w.cm().add(bullet, e);
+    auto deadline = w.deadline_after(lifetime);
+    auto bullet = w.bullet_pool().acquire(
+        w.em(), w.cm(), t, v, r, components::Expirable{.deadline = deadline});
+    w.timers().schedule(deadline,
+                        Timer{.id = bullet, .kind = Timer_kind::expire});
     return bullet;
 }
 
-void systems::AI::update(Entity_manager &em, Component_manager &cm)
+// Bots chase the closest player they can reach, following that player's flow
+// field: turn towards the centre of the next cell, and drive once roughly
+// facing it. All bots chasing the same player share its field.
+void systems::AI::update(World &w, ::Map const &map)
 {
+    constexpr float turn_rate = 4;
+    constexpr auto max_turn = static_cast<float>(std::numbers::pi) * 2;
+    constexpr auto facing = static_cast<float>(std::numbers::pi) / 4;
+    constexpr float speed = 15;
+
+    auto &cm = w.cm();
+    auto players = cm.eager_view<Player_tag, Transform>(&w.frame_arena());
+    w.flow_fields().retain(players);
+    std::pmr::vector<Flow_field const *> fields(&w.frame_arena());
+    for (auto p : players) {
+        auto const &pos = cm.read<Transform>(p).position;
+        if (map.is_valid(pos)) {
+            fields.push_back(
+                &w.flow_fields().toward(p, map, ::Map::cell_of(pos)));
+        }
+    }
 
-    // Randomize bot's velocity and remove their intent to fire
-    for (auto id : cm.view<Bot_tag, components::Weapon>()) {
+    for (auto id : cm.view<Bot_tag, Transform, components::Weapon>()) {
         spdlog::trace("systems::AI entity {} enemy_tag: true", id);
+        auto const &t = cm.read<Transform>(id);
         auto &v = cm.get<Velocity>(id);
-        auto &fire = cm.get<components::Weapon>(id);
-        v.linear = util::rand() % 15;
-        v.angular = util::rand() % 5;
-        fire.active = false;
+        cm.get<components::Weapon>(id).active = false;
+        v = {.linear = 0, .angular = 0};
+        if (!map.is_valid(t.position)) {
+            continue;
+        }
+
+        auto const cell = ::Map::cell_of(t.position);
+        auto closest = std::ranges::min_element(
+            fields, {}, [cell](auto const *f) { return f->cost(cell); });
+        if (closest == fields.end() ||
+            (*closest)->cost(cell) == Flow_field::unreachable) {
+            continue;
+        }
+        auto const step = (*closest)->step(cell);
+        if (step == glm::ivec2{}) {
+            continue; // Already in the player's cell
+        }
+
+        auto const next = glm::vec2(cell + step) + 0.5F;
+        auto const to_next = next - glm::vec2(t.position.x, t.position.z);
+        auto const turn = std::remainder(std::atan2(-to_next.y, to_next.x) -
+                                             t.yaw,
+                                         2 * std::numbers::pi_v<float>);
+        v.angular = std::clamp(turn * turn_rate, -max_turn, max_turn);
+        v.linear = std::abs(turn) < facing ? speed : 0;
     }
 }
 
-void systems::Input::update(Component_manager &cm, Window &window)
+void systems::Input::update(World &world, Window &window)
 {
+    auto &cm = world.cm();
     auto esc = window.key_pressed(GLFW_KEY_ESCAPE);
     auto w = window.key_down(GLFW_KEY_W);
     auto a = window.key_down(GLFW_KEY_A);
@@ -174,7 +287,7 @@ void systems::Input::update(Component_manager &cm, Window &window)
         std::exit(0);
     }
 
-    auto players = cm.eager_view<Player_tag>();
+    auto players = cm.eager_view<Player_tag>(&world.frame_arena());
     if (players.size() >= 1) {
         auto p1 = *std::ranges::next(players.begin(), 0);
         cm.get<Velocity>(p1).angular = std::numbers::pi / 4 * 8 * (a - d);
@@ -190,23 +303,25 @@ void systems::Input::update(Component_manager &cm, Window &window)
     }
 }
 
-void systems::Weapon_system::update(World &world, float dt)
+void systems::Weapon_system::update(World &world)
 {
     for (auto id : world.cm().view<Tank_tag, Transform, components::Weapon>()) {
-        auto &t = world.cm().get<Transform>(id);
+        auto const &t = world.cm().read<Transform>(id);
         auto &w = world.cm().get<components::Weapon>(id);
 
-        w.cooldown -= dt;
-        if (w.cooldown <= 0.F && w.active) {
-            w.cooldown = 1.F / w.fire_rate;
+        if (w.ready && w.active) {
+            w.ready = false;
+            world.timers().schedule(
+                world.deadline_after(1.F / w.fire_rate),
+                Timer{.id = id, .kind = Timer_kind::weapon_ready});
+            // A copy of the tank's transform, so the heading comes cached.
+            auto bullet = t;
+            bullet.position += t.heading() * 2.F;
+            bullet.scale = glm::vec3{0.2};
             Spawner::spawn_bullet(
-                world,
-                Transform{.position = t.position + util::yaw2vec(t.yaw) * 2.F,
-                          .yaw = t.yaw,
-                          .scale = glm::vec3{0.2}},
+                world, bullet,
                 Velocity{.linear = w.bullet_speed, .angular = 0},
-                Renderable{.mesh = &systems::Resources::bullet()},
-                components::Expirable{.remaining_time = 8});
+                Renderable{.mesh = &systems::Resources::bullet()}, 8);
 
             if (world.cm().contains<Player_tag>(id)) {
                 w.active = false;
@@ -215,16 +330,61 @@ void systems::Weapon_system::update(World &world, float dt)
     }
 }
 
-void systems::Expiration::update(World &w, float dt)
+void systems::Weapon_system::reload(World &world, Entity id)
 {
-    std::vector<Entity> expired;
-    for (auto id : w.cm().view<components::Expirable>()) {
-        w.cm().get<components::Expirable>(id).remaining_time -= dt;
-        if (w.cm().get<components::Expirable>(id).remaining_time <= 0) {
-            expired.push_back(id);
-        }
+    if (world.cm().contains<components::Weapon>(id)) {
+        world.cm().get<components::Weapon>(id).ready = true;
     }
-    for (auto id : expired) {
-        w.cm().remove(id);
+}
+
+void systems::Expiration::expire(World &w, Entity id, std::uint64_t deadline)
+{
+    auto &cm = w.cm();
+    if (!cm.is_enabled(id) || !cm.contains<components::Expirable>(id) ||
+        cm.get<components::Expirable>(id).deadline != deadline) {
+        return;
+    }
+    if (cm.contains<Bullet_tag>(id)) {
+        w.bullet_pool().release(cm, id);
+    }
+    else {
+        cm.remove(id);
     }
 }
+
+void systems::Transform_system::update(Component_manager &cm)
+{
+    for (auto id : cm.view<Changed<Transform>>()) {
+        auto const &t = cm.read<Transform>(id);
+        // translate * rotate(yaw, y) * scale, with the rotation's columns
+        // taken from the cached heading.
+        auto const h = t.heading();
+        glm::mat4 const model{
+            glm::vec4{h * t.scale.x, 0},
+            glm::vec4{0, t.scale.y, 0, 0},
+            glm::vec4{glm::vec3{-h.z, 0, h.x} * t.scale.z, 0},
+            glm::vec4{t.position, 1},
+        };
+        if (cm.contains<World_matrix>(id)) {
+            cm.get<World_matrix>(id).model = model;
+        }
+        else {
+            cm.add(id, World_matrix{.model = model});
+        }
+    }
+}
+
+void systems::Timers::update(World &w)
+{
+    auto now = static_cast<std::uint64_t>(w.elapsed() / World::tick_duration);
+    w.timers().advance(now, [&w](std::uint64_t deadline, Timer const &timer) {
+        switch (timer.kind) {
+        case Timer_kind::expire:
+            Expiration::expire(w, timer.id, deadline);
+            break;
+        case Timer_kind::weapon_ready:
+            Weapon_system::reload(w, timer.id);
+            break;
+        }
+    });
+}
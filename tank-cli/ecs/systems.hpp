@@ -2,10 +2,12 @@
 
 #include <glm/glm.hpp>
 #include <random>
+#include <tank-cli/builtin-meshes.hpp>
 #include <tank-cli/camera.hpp>
 #include <tank-cli/ecs/component-manager.hpp>
 #include <tank-cli/ecs/components.hpp>
 #include <tank-cli/ecs/entity-manager.hpp>
+#include <tank-cli/map-loader.hpp>
 #include <tank-cli/map.hpp>
 #include <tank-cli/mesh.hpp>
 #include <tank-cli/shader-program.hpp>
@@ -24,31 +26,29 @@ auto rand();
 
 class Physics {
   public:
-    static void update(Entity_manager &em, Component_manager &cm, float dt,
-                       ::Map const &map);
+    static void update(World &w, float dt, ::Map &map);
 };
 
 class Spawner {
   public:
     static void update(World &w, ::Map &map);
 
+    /// @brief Spawns up to `count` tanks on random free cells.
+    /// @return How many there was room for.
     template <typename Tag>
-    static Entity spawn_tank(World &w, ::Map &map, Tag player_or_bot_tag,
-                             Transform t, Velocity v,
-                             components::Weapon weapon);
-
-    template <typename Tag>
-    static Entity spawn_tank(World &w, ::Map &map, Tag player_or_bot_tag);
+    static std::size_t spawn_tanks(World &w, ::Map &map, Tag player_or_bot_tag,
+                                   std::size_t count);
 
+    /// @param lifetime Seconds until the bullet expires
     static Entity spawn_bullet(World &w, Transform t, Velocity v, Renderable r,
-                               components::Expirable e);
+                               float lifetime);
 
   private:
 };
 
 class AI {
   public:
-    static void update(Entity_manager &em, Component_manager &cm);
+    static void update(World &w, ::Map const &map);
 };
 
 class Map {
@@ -64,17 +64,38 @@ class Map {
 
 class Input {
   public:
-    static void update(Component_manager &cm, Window &window);
+    static void update(World &w, Window &window);
 };
 
 class Weapon_system {
   public:
-    static void update(World &world, float dt);
+    static void update(World &world);
+
+    /// @brief Called by the timer scheduled when the weapon fired.
+    static void reload(World &world, Entity id);
 };
 
 class Expiration {
   public:
-    static void update(World &w, float dt);
+    /// @brief Called by the timer scheduled on spawn. Stale timers, whose
+    /// entity was removed, recycled or given a new deadline, are ignored.
+    static void expire(World &w, Entity id, std::uint64_t deadline);
+};
+
+// Keeps every entity's World_matrix in step with its Transform, adding it on
+// first sight. Only the Transforms written this tick are looked at, so it has
+// to run after everything that moves entities; a frame where nothing moved
+// costs nothing.
+class Transform_system {
+  public:
+    static void update(Component_manager &cm);
+};
+
+// Advances World's timer wheel to the current time and dispatches the timers
+// that became due.
+class Timers {
+  public:
+    static void update(World &w);
 };
 
 class Resources {
@@ -108,66 +129,28 @@ class Resources {
 
     static ::Map &map()
     {
-        constexpr int width = 80;
-        constexpr int height = 60;
-        static ::Map map(width + 1, height + 1);
+        static ::Map map = Map_loader::load("map1.txt");
         return map;
     }
 
     static Mesh &tank()
     {
-        float h = 3.0F;
-        std::vector<glm::vec3> tank_vertices = {
-            {6, h, 3}, {-6, h, 3}, {6, h, -3}, {-6, h, -3},
-            {0, h, 1}, {0, h, -1}, {9, h, 1},  {9, h, -1},
-            {6, 0, 3}, {-6, 0, 3}, {6, 0, -3}, {-6, 0, -3},
-            {0, 0, 1}, {0, 0, -1}, {9, 0, 1},  {9, 0, -1}};
-        std::vector<uint32_t> tank_indices = {
-            0,  1,  2,  1,  3,  2,  4,  5, 6,  5,  7, 6, 10, 9,  8, 10, 11, 9,
-            14, 13, 12, 14, 15, 13, 8,  9, 0,  0,  9, 1, 9,  11, 1, 1,  11, 3,
-            11, 10, 3,  3,  10, 2,  10, 8, 2,  2,  8, 0, 12, 14, 4, 4,  14, 6,
-            13, 5,  15, 15, 5,  7,  12, 4, 13, 13, 4, 5, 14, 15, 6, 6,  15, 7,
-        };
-        static Mesh tank(tank_vertices, tank_indices);
+        static Mesh tank(builtin_meshes::tank.vertices,
+                         builtin_meshes::tank.indices);
         return tank;
     }
 
     static Mesh &bullet()
     {
-        std::vector<glm::vec3> bullet_vertices = {
-            {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, -0.5f},
-            {-0.5f, 0.5f, -0.5f},  {-0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, 0.5f},
-            {0.5f, 0.5f, 0.5f},    {-0.5f, 0.5f, 0.5f}};
-
-        std::vector<uint32_t> bullet_indices = {
-            0, 1, 2, 2, 3, 0, // front face
-            4, 5, 6, 6, 7, 4, // back face
-            7, 3, 0, 0, 4, 7, // left face
-            6, 2, 1, 1, 5, 6, // right face
-            0, 1, 5, 5, 4, 0, // bottom face
-            3, 2, 6, 6, 7, 3  // top face
-        };
-        static Mesh bullet(bullet_vertices, bullet_indices);
+        static Mesh bullet(builtin_meshes::bullet.vertices,
+                           builtin_meshes::bullet.indices);
         return bullet;
     }
 
     static Mesh &barrier_unit()
     {
-        // 顶点定义一个沿 X 方向长度=1，沿 Z 方向厚度=1，高度=1 的盒子
-        static std::vector<glm::vec3> verts = {
-            {-0.5f, -0.5f, -0.5f}, {+0.5f, -0.5f, -0.5f}, {+0.5f, -0.5f, +0.5f},
-            {-0.5f, -0.5f, +0.5f}, {-0.5f, +0.5f, -0.5f}, {+0.5f, +0.5f, -0.5f},
-            {+0.5f, +0.5f, +0.5f}, {-0.5f, +0.5f, +0.5f},
-        };
-        static std::vector<uint32_t> idx = {
-            0, 1, 2, 2, 3, 0, // bottom
-            4, 5, 6, 6, 7, 4, // top
-            0, 1, 5, 5, 4, 0, // front
-            2, 3, 7, 7, 6, 2, // back
-            1, 2, 6, 6, 5, 1, // right
-            3, 0, 4, 4, 7, 3  // left
-        };
-        static Mesh m(verts, idx);
+        static Mesh m(builtin_meshes::unit_box.vertices,
+                      builtin_meshes::unit_box.indices);
         return m;
     }
 };
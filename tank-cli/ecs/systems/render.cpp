@@ -23,26 +23,22 @@ void systems::Render::render(Component_manager &cm, Camera const &cam,
                                      static_cast<float>(window.height()),
                                  0.1F, 200.0F);
 
-    for (auto id : cm.view<Transform, Renderable>()) {
+    // Matrices are kept by systems::Transform_system, so static entities
+    // cost nothing here beyond the draw.
+    auto const view_proj = proj * view;
+    for (auto id : cm.view<World_matrix, Renderable,
+                           Any_of<Bot_tag, Player_tag>>()) {
         spdlog::trace("systems::Render entity renderable: {}", id);
-        auto &t = cm.get<Transform>(id);
-        auto &r = cm.get<Renderable>(id);
-        glm::mat4 model(1);
-        model = glm::translate(model, t.position);
-        model = glm::rotate(model, t.yaw, {0, 1, 0});
-        model = glm::scale(model, t.scale);
-        if (cm.contains<Bot_tag>(id) || cm.contains<Player_tag>(id)) {
-            player_shader.uniform_mat4("uMVP", proj * view * model);
-            r.mesh->render(player_shader);
-        }
-        else if (cm.contains<Barrier_tag>(id)) {
-            env_shader.uniform_mat4("uMVP", proj * view * model);
-            r.mesh->render(env_shader);
-        }
-        else {
-            env_shader.uniform_mat4("uMVP", proj * view * model);
-            r.mesh->render(env_shader);
-        }
+        player_shader.uniform_mat4("uMVP",
+                                   view_proj * cm.read<World_matrix>(id).model);
+        cm.read<Renderable>(id).mesh->render(player_shader);
+    }
+    for (auto id : cm.view<World_matrix, Renderable,
+                           Without<Bot_tag, Player_tag>>()) {
+        spdlog::trace("systems::Render entity renderable: {}", id);
+        env_shader.uniform_mat4("uMVP",
+                                view_proj * cm.read<World_matrix>(id).model);
+        cm.read<Renderable>(id).mesh->render(env_shader);
     }
 
     window.swap_buffers();
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timing wheel. Timers are scheduled at an absolute tick and fire
+// when the wheel is advanced past it. Each tick only touches the bucket that is
+// due (plus an occasional cascade from a coarser level), so the cost per tick
+// is proportional to the number of timers firing, not to the number pending.
+//
+// Level `l` has 64 slots of 64^l ticks each; four levels cover 2^24 ticks.
+// Timers further away than that are parked in the last level and cascaded again
+// until they are in range.
+template <typename T> class Timer_wheel {
+  public:
+    using Tick = std::uint64_t;
+
+    [[nodiscard]] Tick now() const
+    {
+        return now_;
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return size_;
+    }
+
+    /// @brief Schedules `value` at `deadline`. Deadlines which are not in the
+    /// future fire on the next tick.
+    void schedule(Tick deadline, T value)
+    {
+        ++size_;
+        insert({.deadline = std::max(deadline, now_ + 1),
+                .value = std::move(value)});
+    }
+
+    /// @brief Advances the wheel to `tick`, calling `on_due(deadline, value)`
+    /// for every timer due on the way. Callbacks may schedule new timers.
+    template <typename Fn> void advance(Tick tick, Fn &&on_due)
+    {
+        while (now_ < tick) {
+            ++now_;
+            cascade();
+            due_.swap(levels_[0][now_ & slot_mask]);
+            size_ -= due_.size();
+            for (auto const &e : due_) {
+                on_due(e.deadline, e.value);
+            }
+            due_.clear();
+        }
+    }
+
+  private:
+    static constexpr int slot_bits{6};
+    static constexpr std::size_t slots{1UZ << slot_bits};
+    static constexpr Tick slot_mask{slots - 1};
+    static constexpr int level_count{4};
+
+    struct Entry {
+        Tick deadline;
+        T value;
+    };
+
+    std::array<std::array<std::vector<Entry>, slots>, level_count> levels_;
+    std::vector<Entry> due_;
+    std::vector<Entry> cascading_;
+    Tick now_{};
+    std::size_t size_{};
+
+    void insert(Entry e)
+    {
+        auto delta = e.deadline - now_;
+        int level{};
+        while (level != level_count - 1 &&
+               delta >= (Tick{1} << (slot_bits * (level + 1)))) {
+            ++level;
+        }
+        auto slot = (e.deadline >> (slot_bits * level)) & slot_mask;
+        levels_[level][slot].push_back(std::move(e));
+    }
+
+    // Whenever a coarser slot begins, its timers are redistributed to finer
+    // levels. Those due right now land in the level 0 slot processed next.
+    void cascade()
+    {
+        for (int level{1}; level != level_count; ++level) {
+            auto shift = slot_bits * level;
+            if ((now_ & ((Tick{1} << shift) - 1)) != 0) {
+                return;
+            }
+            cascading_.swap(levels_[level][(now_ >> shift) & slot_mask]);
+            for (auto &e : cascading_) {
+                insert(std::move(e));
+            }
+            cascading_.clear();
+        }
+    }
+};
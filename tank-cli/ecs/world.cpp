@@ -1,9 +1,18 @@
+#include <algorithm>
 #include <tank-cli/ecs/components.hpp>
 #include <tank-cli/ecs/systems/render.hpp>
 #include <tank-cli/ecs/world.hpp>
+#include <tank-cli/morton.hpp>
 
-World::World()
+World::World(Storage_mode storage_mode)
+    : cm_(storage_mode),
+      frame_buffer_(std::make_unique<std::byte[]>(frame_arena_size)),
+      frame_arena_(frame_buffer_.get(), frame_arena_size)
 {
+    cm_.on_add<Bot_tag>(
+        [this](std::span<Entity const> ids) { bot_count_ += ids.size(); });
+    cm_.on_remove<Bot_tag>(
+        [this](std::span<Entity const> ids) { bot_count_ -= ids.size(); });
     init();
 }
 
@@ -61,35 +70,85 @@ void World::init()
 
             // 5) Attach it
             cm_.add(id, Renderable{.mesh = mesh});
+            return id;
         };
 
-        auto width = systems::Resources::map().fwidth();
-        auto height = systems::Resources::map().fheight();
-        // outer rectangle
-        spawn_barrier({0, 0}, {width, 0});
-        spawn_barrier({width, 0}, {width, height});
-        spawn_barrier({width, height}, {0, height});
-        spawn_barrier({0, height}, {0, 0});
-
-        // two interior lines
-        spawn_barrier({width / 3.f, 0}, {width / 3.f, height / 3.f * 2});
-        spawn_barrier({width / 3.f * 2, height / 3.f},
-                      {width / 3.f * 2, height});
+        auto const &barriers = systems::Resources::map().barriers();
+        for (Barrier_id i{}; i != barriers.size(); ++i) {
+            if (auto const &b = barriers[i]) {
+                barrier_entities_[i] = spawn_barrier(b->start, b->end);
+            }
+        }
     }
 }
 
+void World::despawn_barrier(Barrier_id id)
+{
+    systems::Resources::map().remove_barrier(id);
+
+    auto it = barrier_entities_.find(id);
+    if (it == barrier_entities_.end()) {
+        return;
+    }
+    // Each barrier owns its mesh, see init().
+    delete cm_.get<Renderable>(it->second).mesh;
+    cm_.remove(it->second);
+    barrier_entities_.erase(it);
+}
+
 void World::update(float dt, float t)
 {
-    systems::Input::update(cm_, systems::Resources::main_window());
-    systems::Spawner::update(*this, systems::Resources::map());
-    systems::AI::update(em_, cm_);
-    systems::Weapon_system::update(*this, dt);
-    systems::Physics::update(em_, cm_, dt, systems::Resources::map());
-    systems::Expiration::update(*this, dt);
-    systems::Render::render(cm_, systems::Resources::camera(),
-                            systems::Resources::main_window(),
-                            systems::Resources::player_shader(),
-                            systems::Resources::env_shader(), t);
+    elapsed_ += dt;
+
+    alloc_report_.begin_frame();
+    if (planner_) {
+        alloc_report_.measure(
+            "Planner", [&] { planner_->patch(systems::Resources::map()); });
+    }
+    alloc_report_.measure("Input", [&] {
+        systems::Input::update(*this, systems::Resources::main_window());
+    });
+    alloc_report_.measure("Spawner", [&] {
+        systems::Spawner::update(*this, systems::Resources::map());
+    });
+    alloc_report_.measure("AI", [&] {
+        systems::AI::update(*this, systems::Resources::map());
+    });
+    alloc_report_.measure("Timers", [&] { systems::Timers::update(*this); });
+    alloc_report_.measure("Weapon_system",
+                          [&] { systems::Weapon_system::update(*this); });
+    alloc_report_.measure("Physics", [&] {
+        systems::Physics::update(*this, dt, systems::Resources::map());
+    });
+    alloc_report_.measure("Transform_system",
+                          [&] { systems::Transform_system::update(cm_); });
+    // Keep entities that are close on the map close in memory, for the
+    // neighbourhood queries: every few frames, one archetype is reordered
+    // along the Z-order curve of the map cells.
+    if (frame_ % sort_interval == 0) {
+        alloc_report_.measure("Spatial_sort", [&] {
+            auto const moved = cm_.sort_step<Transform>([](Transform const &t) {
+                return morton(static_cast<std::uint32_t>(
+                                  std::max(t.position.x, 0.F)),
+                              static_cast<std::uint32_t>(
+                                  std::max(t.position.z, 0.F)));
+            });
+            if (moved) {
+                bullet_pool_.motion().rebind(cm_);
+            }
+        });
+    }
+    alloc_report_.measure("Render", [&] {
+        systems::Render::render(cm_, systems::Resources::camera(),
+                                systems::Resources::main_window(),
+                                systems::Resources::player_shader(),
+                                systems::Resources::env_shader(), t);
+    });
+    alloc_report_.end_frame(frame_++);
+    cm_.advance_tick();
+
+    // Everything allocated from the arena during this frame is dead now.
+    frame_arena_.release();
 
     GLenum err;
     while ((err = glGetError()) != GL_NO_ERROR) {
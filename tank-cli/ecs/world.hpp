@@ -1,16 +1,40 @@
 #pragma once
 
+#include <cmath>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <tank-cli/alloc-tracker.hpp>
+#include <tank-cli/ecs/bullet-pool.hpp>
 #include <tank-cli/ecs/component-manager.hpp>
 #include <tank-cli/ecs/entity-manager.hpp>
 #include <tank-cli/ecs/systems.hpp>
+#include <tank-cli/ecs/timer-wheel.hpp>
+#include <tank-cli/flow-field.hpp>
+#include <tank-cli/hpa-planner.hpp>
+#include <tank-cli/map.hpp>
+#include <unordered_map>
+
+enum class Timer_kind : std::uint8_t { expire, weapon_ready };
+
+struct Timer {
+    Entity id;
+    Timer_kind kind;
+};
 
 // Entity Component System
 class World {
   public:
-    World();
+    // Timers run at a fixed resolution, independent of the frame rate.
+    static constexpr float tick_duration{1.F / 128};
+
+    explicit World(Storage_mode storage_mode = Storage_mode::maps);
     void init();
     void update(float dt, float t);
 
+    /// @brief Removes a barrier from the map along with its render entity.
+    void despawn_barrier(Barrier_id id);
+
     [[nodiscard]] Entity_manager &em()
     {
         return em_;
@@ -21,7 +45,76 @@ class World {
         return cm_;
     }
 
+    [[nodiscard]] Bullet_pool &bullet_pool()
+    {
+        return bullet_pool_;
+    }
+
+    /// @brief Flow fields toward whatever the bots chase, see systems::AI.
+    [[nodiscard]] Flow_fields &flow_fields()
+    {
+        return flow_fields_;
+    }
+
+    /// @brief Paths for bots with goals of their own. Built on first use,
+    /// then kept in sync with the map at the start of every update. Its
+    /// worker is joined when the World goes, and the futures of submit()
+    /// still pending then are broken.
+    [[nodiscard]] Hpa_planner &planner()
+    {
+        if (!planner_) {
+            planner_.emplace(systems::Resources::map());
+        }
+        return *planner_;
+    }
+
+    /// @brief Entities with a Bot_tag, as of the end of the previous update.
+    [[nodiscard]] std::size_t bot_count() const
+    {
+        return bot_count_;
+    }
+
+    [[nodiscard]] Timer_wheel<Timer> &timers()
+    {
+        return timers_;
+    }
+
+    /// @brief Seconds of game time simulated so far.
+    [[nodiscard]] double elapsed() const
+    {
+        return elapsed_;
+    }
+
+    /// @brief The tick `seconds` from now, rounded up.
+    [[nodiscard]] std::uint64_t deadline_after(float seconds) const
+    {
+        return timers_.now() +
+               static_cast<std::uint64_t>(std::ceil(seconds / tick_duration));
+    }
+
+    /// @brief Monotonic arena for temporaries living no longer than a frame.
+    /// It's reset at the end of every World::update.
+    [[nodiscard]] std::pmr::memory_resource &frame_arena()
+    {
+        return frame_arena_;
+    }
+
   private:
+    static constexpr auto frame_arena_size{64UZ * 1024};
+    // Frames between two steps of the spatial sort, see update().
+    static constexpr std::size_t sort_interval{8};
+
     Entity_manager em_;
     Component_manager cm_;
+    Bullet_pool bullet_pool_;
+    Timer_wheel<Timer> timers_;
+    Flow_fields flow_fields_;
+    std::optional<Hpa_planner> planner_; // See planner()
+    double elapsed_{};
+    std::unique_ptr<std::byte[]> frame_buffer_;
+    std::pmr::monotonic_buffer_resource frame_arena_;
+    Frame_alloc_report alloc_report_;
+    std::size_t frame_{};
+    std::unordered_map<Barrier_id, Entity> barrier_entities_;
+    std::size_t bot_count_{}; // Kept by Bot_tag hooks, see World()
 };
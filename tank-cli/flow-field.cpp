@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <tank-cli/flow-field.hpp>
+
+bool Flow_field::can_step(Map const &map, glm::ivec2 from, std::uint8_t s)
+{
+    auto movable = [&map](glm::ivec2 c) {
+        return map.is_valid_cell(c) &&
+               map.cell(c).terrain() == Terrain::movable;
+    };
+    auto const d = steps[s].offset;
+    if (!movable(from + d)) {
+        return false;
+    }
+    return d.x == 0 || d.y == 0 ||
+           (movable({from.x + d.x, from.y}) && movable({from.x, from.y + d.y}));
+}
+
+void Flow_field::build(Map const &map, glm::ivec2 target)
+{
+    target_ = target;
+    revision_ = map.revision();
+    cost_ = Chunked_grid<std::uint32_t>(map.width(), map.height(),
+                                        unreachable);
+    step_ = Chunked_grid<std::uint8_t>(map.width(), map.height(), none);
+    reached_lo_ = {0, 0};
+    reached_hi_ = {-1, -1};
+    if (!map.is_valid_cell(target)) {
+        return;
+    }
+
+    // Dijkstra outwards from the target. Steps are symmetric, so the cost
+    // from the target to a cell is the cost from that cell to the target.
+    Open open;
+    cost_.set(target.x, target.y, 0);
+    open.emplace(0, target);
+    reached_lo_ = target;
+    reached_hi_ = target;
+    settled_.clear();
+    search(map, open);
+
+    // Every reached cell steps to its cheapest neighbour, so following the
+    // steps walks a shortest path.
+    for (auto cell : settled_) {
+        update_step(map, cell);
+    }
+}
+
+// A change can only lengthen the paths through the changed cells, and shorten
+// paths by opening ways through them. So the cells whose costs were reached
+// through a changed region (or past its corners, hence the extra cell around
+// it) lose them, then the search resumes from their reachable neighbours and
+// from the regions themselves. Every cell whose cost went down is settled
+// again, so with its neighbours, it gets its step updated; the cells that
+// lost their costs too.
+void Flow_field::patch(Map const &map)
+{
+    if (map.revision() == revision_) {
+        return;
+    }
+    auto const dirty = map.dirty_since(revision_);
+    if (!dirty) {
+        build(map, target_);
+        return;
+    }
+    revision_ = map.revision();
+
+    auto grown = [&map](Dirty_region const &r) {
+        return std::pair(glm::max(r.lo - 1, glm::ivec2(0)),
+                         glm::min(r.hi + 1, glm::ivec2(map.width() - 1,
+                                                       map.height() - 1)));
+    };
+    auto overlaps = [this](glm::ivec2 lo, glm::ivec2 hi) {
+        return lo.x <= reached_hi_.x + 1 && reached_lo_.x - 1 <= hi.x &&
+               lo.y <= reached_hi_.y + 1 && reached_lo_.y - 1 <= hi.y;
+    };
+    auto lose = [this](glm::ivec2 cell) {
+        if (auto const c = cost_.get(cell.x, cell.y); c != unreachable) {
+            cost_.set(cell.x, cell.y, unreachable);
+            lost_.emplace_back(c, cell);
+        }
+    };
+
+    lost_.clear();
+    for (auto const &region : *dirty) {
+        auto const [lo, hi] = grown(region);
+        if (!overlaps(lo, hi)) {
+            continue;
+        }
+        if (glm::all(glm::greaterThanEqual(target_, lo)) &&
+            glm::all(glm::lessThanEqual(target_, hi))) {
+            build(map, target_);
+            return;
+        }
+        for (int z{lo.y}; z <= hi.y; ++z) {
+            for (int x{lo.x}; x <= hi.x; ++x) {
+                lose({x, z});
+            }
+        }
+    }
+    // Then whatever may have been reached through a cell that lost its cost.
+    // Steps go to the cheapest neighbour, which isn't always the one a cost
+    // came through, so costs are compared instead.
+    for (std::size_t i{}; i != lost_.size(); ++i) {
+        auto const [cost, cell] = lost_[i];
+        for (std::uint8_t s{}; s != none; ++s) {
+            auto const from = cell - steps[s].offset;
+            if (map.is_valid_cell(from) &&
+                cost_.get(from.x, from.y) == cost + steps[s].cost) {
+                lose(from);
+            }
+        }
+    }
+
+    Open open;
+    auto reopen = [&](glm::ivec2 cell) {
+        auto best = cost_.get(cell.x, cell.y);
+        for (std::uint8_t s{}; s != none; ++s) {
+            auto const from = cell - steps[s].offset;
+            if (!map.is_valid_cell(from) || !can_step(map, from, s)) {
+                continue;
+            }
+            auto const c = cost_.get(from.x, from.y);
+            if (c != unreachable && c + steps[s].cost < best) {
+                best = c + steps[s].cost;
+            }
+        }
+        if (best < cost_.get(cell.x, cell.y) && best <= max_cost) {
+            cost_.set(cell.x, cell.y, best);
+            open.emplace(best, cell);
+        }
+    };
+    for (auto const &[cost, cell] : lost_) {
+        reopen(cell);
+    }
+    for (auto const &region : *dirty) {
+        auto const [lo, hi] = grown(region);
+        if (!overlaps(lo, hi)) {
+            continue;
+        }
+        for (int z{lo.y}; z <= hi.y; ++z) {
+            for (int x{lo.x}; x <= hi.x; ++x) {
+                reopen({x, z});
+            }
+        }
+    }
+    settled_.clear();
+    search(map, open);
+
+    for (auto const &[cost, cell] : lost_) {
+        update_step(map, cell);
+    }
+    for (auto cell : settled_) {
+        update_step(map, cell);
+        for (std::uint8_t s{}; s != none; ++s) {
+            auto const next = cell + steps[s].offset;
+            if (map.is_valid_cell(next)) {
+                update_step(map, next);
+            }
+        }
+    }
+}
+
+void Flow_field::search(Map const &map, Open &open)
+{
+    while (!open.empty()) {
+        auto const [cost, cell] = open.top();
+        open.pop();
+        if (cost != cost_.get(cell.x, cell.y)) {
+            continue; // Superseded by a cheaper entry
+        }
+        settled_.push_back(cell);
+        reached_lo_ = glm::min(reached_lo_, cell);
+        reached_hi_ = glm::max(reached_hi_, cell);
+        for (std::uint8_t s{}; s != none; ++s) {
+            auto const next_cost = cost + steps[s].cost;
+            if (next_cost > max_cost || !can_step(map, cell, s)) {
+                continue;
+            }
+            auto const next = cell + steps[s].offset;
+            if (next_cost < cost_.get(next.x, next.y)) {
+                cost_.set(next.x, next.y, next_cost);
+                open.emplace(next_cost, next);
+            }
+        }
+    }
+}
+
+void Flow_field::update_step(Map const &map, glm::ivec2 cell)
+{
+    auto best = cost_.get(cell.x, cell.y);
+    auto step = none;
+    if (best != unreachable) {
+        for (std::uint8_t s{}; s != none; ++s) {
+            if (!can_step(map, cell, s)) {
+                continue;
+            }
+            auto const next = cell + steps[s].offset;
+            auto const c = cost_.get(next.x, next.y);
+            if (c < best) {
+                best = c;
+                step = s;
+            }
+        }
+    }
+    step_.set(cell.x, cell.y, step);
+}
+
+Flow_field const &Flow_fields::toward(std::uint64_t key, Map const &map,
+                                      glm::ivec2 target)
+{
+    auto &field = fields_[key];
+    if (field.empty() || field.target() != target) {
+        field.build(map, target);
+    }
+    else {
+        field.patch(map);
+    }
+    return field;
+}
+
+void Flow_fields::retain(std::span<std::uint64_t const> keys)
+{
+    std::erase_if(fields_, [keys](auto const &kv) {
+        return std::ranges::find(keys, kv.first) == keys.end();
+    });
+}
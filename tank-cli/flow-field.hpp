@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <queue>
+#include <span>
+#include <tank-cli/chunked-grid.hpp>
+#include <tank-cli/map.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Shortest paths from the cells of a Map around one target cell to it, stored
+// as the step to take from each cell. Built with Dijkstra over the movable
+// cells of the 8-connected grid; a diagonal step is only allowed if both cells
+// it cuts past are movable too, so units don't clip wall corners. The search
+// stops at max_cost, and the field is kept in chunks like the map, so only the
+// chunks it reached take memory, however big the map.
+//
+// Any number of units heading for the same target share one field, and each
+// of them finds its way with a single lookup.
+class Flow_field {
+  public:
+    // Costs are in tenths of a cell: 10 per orthogonal step, 14 per diagonal.
+    static constexpr std::uint32_t unreachable{
+        std::numeric_limits<std::uint32_t>::max()};
+    // Cells farther than this, about 512 cells, are left unreachable.
+    static constexpr std::uint32_t max_cost{5120};
+
+    void build(Map const &map, glm::ivec2 target);
+
+    /// @brief Brings the field up to Map::revision(), redoing only the paths
+    /// through the regions changed since revision(). Builds it anew if those
+    /// regions are no longer known, or the target is in one.
+    void patch(Map const &map);
+
+    [[nodiscard]] glm::ivec2 target() const
+    {
+        return target_;
+    }
+
+    /// @brief Map::revision() the field was built at.
+    [[nodiscard]] std::uint64_t revision() const
+    {
+        return revision_;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return cost_.chunks_x() == 0;
+    }
+
+    /// @brief Path cost from `cell` to the target. No bounds check.
+    [[nodiscard]] std::uint32_t cost(glm::ivec2 cell) const
+    {
+        return cost_.get(cell.x, cell.y);
+    }
+
+    /// @brief Offset of the next cell on the way from `cell` to the target,
+    /// zero at the target and where it can't be reached. No bounds check.
+    [[nodiscard]] glm::ivec2 step(glm::ivec2 cell) const
+    {
+        return steps[step_.get(cell.x, cell.y)].offset;
+    }
+
+    /// @brief step() as a unit vector on the xz plane.
+    [[nodiscard]] glm::vec2 direction(glm::ivec2 cell) const
+    {
+        return steps[step_.get(cell.x, cell.y)].direction;
+    }
+
+  private:
+    struct Step {
+        glm::ivec2 offset;
+        glm::vec2 direction;
+        std::uint32_t cost;
+    };
+
+    // The 8 neighbours, then "stay".
+    static constexpr std::uint8_t none{8};
+    static constexpr float diagonal{0.70710678F};
+    static constexpr Step steps[]{
+        {.offset = {1, 0}, .direction = {1, 0}, .cost = 10},
+        {.offset = {-1, 0}, .direction = {-1, 0}, .cost = 10},
+        {.offset = {0, 1}, .direction = {0, 1}, .cost = 10},
+        {.offset = {0, -1}, .direction = {0, -1}, .cost = 10},
+        {.offset = {1, 1}, .direction = {diagonal, diagonal}, .cost = 14},
+        {.offset = {1, -1}, .direction = {diagonal, -diagonal}, .cost = 14},
+        {.offset = {-1, 1}, .direction = {-diagonal, diagonal}, .cost = 14},
+        {.offset = {-1, -1}, .direction = {-diagonal, -diagonal}, .cost = 14},
+        {.offset = {0, 0}, .direction = {0, 0}, .cost = 0},
+    };
+
+    using Entry = std::pair<std::uint32_t, glm::ivec2>;
+    struct Later {
+        bool operator()(Entry const &a, Entry const &b) const
+        {
+            return a.first > b.first;
+        }
+    };
+    using Open = std::priority_queue<Entry, std::vector<Entry>, Later>;
+
+    glm::ivec2 target_{};
+    std::uint64_t revision_{};
+    Chunked_grid<std::uint32_t> cost_{0, 0, unreachable};
+    Chunked_grid<std::uint8_t> step_{0, 0, none}; // Index into steps
+    // Bounds of the cells ever reached, so far away changes are skipped.
+    glm::ivec2 reached_lo_{};
+    glm::ivec2 reached_hi_{-1, -1};
+    // Scratch of build() and patch().
+    std::vector<glm::ivec2> settled_;
+    std::vector<Entry> lost_; // With the cost they had
+
+    // Whether moving from `from` by steps[s] stays on movable cells.
+    [[nodiscard]] static bool can_step(Map const &map, glm::ivec2 from,
+                                       std::uint8_t s);
+
+    /// @brief Dijkstra from the cells in `open`, whose costs are set already,
+    /// up to max_cost. The cells settled are appended to settled_.
+    void search(Map const &map, Open &open);
+
+    /// @brief Points `cell` at its cheapest neighbour, if it's reachable.
+    void update_step(Map const &map, glm::ivec2 cell);
+};
+
+// Flow fields keyed by whatever is being chased, e.g. a player entity. A field
+// is only rebuilt when its target moves to another cell, and patched when the
+// map changes.
+class Flow_fields {
+  public:
+    /// @brief The field toward `target` for `key`, brought up to date.
+    /// References stay valid until the key is dropped by retain().
+    Flow_field const &toward(std::uint64_t key, Map const &map,
+                             glm::ivec2 target);
+
+    /// @brief Drops the fields of every key not in `keys`.
+    void retain(std::span<std::uint64_t const> keys);
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return fields_.size();
+    }
+
+  private:
+    std::unordered_map<std::uint64_t, Flow_field> fields_;
+};
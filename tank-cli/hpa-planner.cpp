@@ -0,0 +1,447 @@
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <tank-cli/hpa-planner.hpp>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+struct Step {
+    glm::ivec2 offset;
+    std::uint32_t cost;
+};
+
+constexpr Step steps[]{
+    {.offset = {1, 0}, .cost = 10},  {.offset = {-1, 0}, .cost = 10},
+    {.offset = {0, 1}, .cost = 10},  {.offset = {0, -1}, .cost = 10},
+    {.offset = {1, 1}, .cost = 14},  {.offset = {1, -1}, .cost = 14},
+    {.offset = {-1, 1}, .cost = 14}, {.offset = {-1, -1}, .cost = 14},
+};
+constexpr std::uint8_t no_step{8};
+
+// Runs of open border cells shorter than this get one entrance in the middle,
+// longer ones one at each end.
+constexpr int long_entrance{6};
+
+// Exact path cost on an empty 8-connected grid, so never more than the real
+// one.
+std::uint32_t octile(glm::ivec2 a, glm::ivec2 b)
+{
+    auto const dx = std::abs(a.x - b.x);
+    auto const dz = std::abs(a.y - b.y);
+    return static_cast<std::uint32_t>((10 * std::max(dx, dz)) +
+                                      (4 * std::min(dx, dz)));
+}
+
+template <typename T>
+using Min_heap = std::priority_queue<T, std::vector<T>, std::greater<>>;
+
+} // namespace
+
+Hpa_planner::Hpa_planner(Map const &map)
+    : width_(map.width()), height_(map.height()),
+      clusters_x_((width_ + cluster_size - 1) / cluster_size),
+      clusters_z_((height_ + cluster_size - 1) / cluster_size),
+      revision_(map.revision()),
+      passable_(width_, height_, 1),
+      cluster_nodes_(static_cast<std::size_t>(clusters_x_) * clusters_z_),
+      border_nodes_(cluster_nodes_.size() * 2)
+{
+    copy_terrain(map, {0, 0}, {width_ - 1, height_ - 1});
+    auto const clusters = static_cast<int>(cluster_nodes_.size());
+    for (int c{}; c != clusters; ++c) {
+        scan_border(c, Side::east);
+        scan_border(c, Side::south);
+    }
+    for (int c{}; c != clusters; ++c) {
+        link_cluster(c);
+    }
+}
+
+// A changed cell can only move the entrances on the borders of its own
+// cluster, and those only change the links within the clusters on either side
+// of them. Everything else is left alone.
+void Hpa_planner::patch(Map const &map)
+{
+    if (map.revision() == revision_) {
+        return;
+    }
+    std::unique_lock lock(mutex_);
+
+    // Too far behind to patch, everything is redone.
+    Dirty_region const whole{.revision = map.revision(),
+                             .lo = {0, 0},
+                             .hi = {width_ - 1, height_ - 1}};
+    auto const dirty = map.dirty_since(revision_);
+    auto const regions = dirty ? *dirty : std::span(&whole, 1);
+
+    std::vector<int> clusters;
+    for (auto const &region : regions) {
+        copy_terrain(map, region.lo, region.hi);
+        for (int cz{region.lo.y / cluster_size};
+             cz <= region.hi.y / cluster_size; ++cz) {
+            for (int cx{region.lo.x / cluster_size};
+                 cx <= region.hi.x / cluster_size; ++cx) {
+                clusters.push_back((cz * clusters_x_) + cx);
+            }
+        }
+    }
+    revision_ = map.revision();
+
+    std::vector<std::pair<int, Side>> borders;
+    for (auto c : clusters) {
+        borders.emplace_back(c, Side::east);
+        borders.emplace_back(c, Side::south);
+        if (c % clusters_x_ != 0) {
+            borders.emplace_back(c - 1, Side::east);
+        }
+        if (c >= clusters_x_) {
+            borders.emplace_back(c - clusters_x_, Side::south);
+        }
+    }
+    std::ranges::sort(borders);
+    borders.erase(std::ranges::unique(borders).begin(), borders.end());
+
+    for (auto [c, side] : borders) {
+        clear_border(c, side);
+    }
+    clusters.clear();
+    for (auto [c, side] : borders) {
+        scan_border(c, side);
+        clusters.push_back(c);
+        auto const neighbour = side == Side::east ? c + 1 : c + clusters_x_;
+        if (side == Side::east ? (c % clusters_x_) + 1 != clusters_x_
+                               : neighbour < std::ssize(cluster_nodes_)) {
+            clusters.push_back(neighbour);
+        }
+    }
+    std::ranges::sort(clusters);
+    clusters.erase(std::ranges::unique(clusters).begin(), clusters.end());
+    for (auto c : clusters) {
+        link_cluster(c);
+    }
+}
+
+std::optional<Hpa_planner::Path> Hpa_planner::find(Query query) const
+{
+    std::shared_lock lock(mutex_);
+    if (!is_passable(query.start) || !is_passable(query.goal)) {
+        return std::nullopt;
+    }
+
+    std::vector<std::uint32_t> from_start;
+    std::vector<std::uint32_t> to_goal;
+    search_cluster(query.start, from_start);
+    search_cluster(query.goal, to_goal);
+    auto const start_cluster = cluster_of(query.start);
+    auto const goal_cluster = cluster_of(query.goal);
+
+    // A* over the abstract graph, with the start and goal as two extra nodes
+    // linked to the nodes of their clusters.
+    auto const start_id = static_cast<std::uint32_t>(nodes_.size());
+    auto const goal_id = start_id + 1;
+    std::unordered_map<std::uint32_t, std::uint32_t> g;
+    std::unordered_map<std::uint32_t, std::uint32_t> parent;
+    Min_heap<std::pair<std::uint32_t, std::uint32_t>> open;
+    auto relax = [&](std::uint32_t id, std::uint32_t cost, std::uint32_t from,
+                     glm::ivec2 cell) {
+        auto it = g.find(id);
+        if (it != g.end() && it->second <= cost) {
+            return;
+        }
+        g[id] = cost;
+        parent[id] = from;
+        open.emplace(cost + octile(cell, query.goal), id);
+    };
+
+    if (start_cluster == goal_cluster &&
+        from_start[local_index(query.goal)] != unreachable) {
+        relax(goal_id, from_start[local_index(query.goal)], start_id,
+              query.goal);
+    }
+    for (auto id : cluster_nodes_[start_cluster]) {
+        auto const cell = nodes_[id]->cell;
+        if (from_start[local_index(cell)] != unreachable) {
+            relax(id, from_start[local_index(cell)], start_id, cell);
+        }
+    }
+    while (!open.empty()) {
+        auto const [f, id] = open.top();
+        open.pop();
+        if (id == goal_id) {
+            break;
+        }
+        auto const &node = *nodes_[id];
+        auto const cost = g[id];
+        if (f != cost + octile(node.cell, query.goal)) {
+            continue; // Superseded by a cheaper entry
+        }
+        if (node.cluster == goal_cluster &&
+            to_goal[local_index(node.cell)] != unreachable) {
+            relax(goal_id, cost + to_goal[local_index(node.cell)], id,
+                  query.goal);
+        }
+        relax(node.partner, cost + steps[0].cost, id,
+              nodes_[node.partner]->cell);
+        for (auto e : node.edges) {
+            relax(e.to, cost + e.cost, id, nodes_[e.to]->cell);
+        }
+    }
+
+    auto const it = g.find(goal_id);
+    if (it == g.end()) {
+        return std::nullopt;
+    }
+    Path path{.waypoints = {query.goal}, .cost = it->second};
+    for (auto id = parent[goal_id]; id != start_id; id = parent[id]) {
+        path.waypoints.push_back(nodes_[id]->cell);
+    }
+    path.waypoints.push_back(query.start);
+    std::ranges::reverse(path.waypoints);
+    // The start or goal may sit right on an entrance.
+    path.waypoints.erase(std::ranges::unique(path.waypoints).begin(),
+                         path.waypoints.end());
+    return path;
+}
+
+std::vector<glm::ivec2> Hpa_planner::refine(glm::ivec2 from,
+                                            glm::ivec2 to) const
+{
+    std::shared_lock lock(mutex_);
+    if (!is_passable(from) || !is_passable(to)) {
+        return {};
+    }
+    if (cluster_of(from) != cluster_of(to)) {
+        // Only the two sides of an entrance are in different clusters.
+        auto const d = to - from;
+        if (std::abs(d.x) + std::abs(d.y) == 1) {
+            return {to};
+        }
+        return {};
+    }
+
+    std::vector<std::uint32_t> costs;
+    std::vector<std::uint8_t> parents;
+    search_cluster(from, costs, &parents);
+    if (costs[local_index(to)] == unreachable) {
+        return {};
+    }
+    std::vector<glm::ivec2> cells;
+    for (auto c = to; c != from;) {
+        cells.push_back(c);
+        c = c - steps[parents[local_index(c)]].offset;
+    }
+    std::ranges::reverse(cells);
+    return cells;
+}
+
+std::future<std::vector<std::optional<Hpa_planner::Path>>>
+Hpa_planner::submit(std::vector<Query> queries) const
+{
+    std::scoped_lock lock(batches_mutex_);
+    if (!worker_.joinable()) {
+        worker_ = std::jthread([this](std::stop_token stop) { work(stop); });
+    }
+    auto &batch = batches_.emplace_back(
+        Batch{.queries = std::move(queries), .paths = {}});
+    auto paths = batch.paths.get_future();
+    batches_ready_.notify_one();
+    return paths;
+}
+
+void Hpa_planner::work(std::stop_token const &stop) const
+{
+    while (true) {
+        Batch batch;
+        {
+            std::unique_lock lock(batches_mutex_);
+            if (!batches_ready_.wait(lock, stop,
+                                     [this] { return !batches_.empty(); })) {
+                return; // Stopping, the queued batches are dropped
+            }
+            batch = std::move(batches_.front());
+            batches_.pop_front();
+        }
+        std::vector<std::optional<Path>> paths;
+        paths.reserve(batch.queries.size());
+        for (auto const &q : batch.queries) {
+            paths.push_back(find(q));
+        }
+        batch.paths.set_value(std::move(paths));
+    }
+}
+
+std::size_t Hpa_planner::node_count() const
+{
+    std::shared_lock lock(mutex_);
+    return nodes_.size() - free_nodes_.size();
+}
+
+void Hpa_planner::copy_terrain(Map const &map, glm::ivec2 lo, glm::ivec2 hi)
+{
+    for (int z{lo.y}; z <= hi.y; ++z) {
+        for (int x{lo.x}; x <= hi.x; ++x) {
+            auto const movable =
+                map.cell({x, z}).terrain() == Terrain::movable;
+            passable_.set(x, z, movable ? 1 : 0);
+        }
+    }
+    passable_.compact(lo.x, lo.y, hi.x, hi.y);
+}
+
+std::uint32_t Hpa_planner::add_node(glm::ivec2 cell)
+{
+    std::uint32_t id{};
+    if (free_nodes_.empty()) {
+        id = static_cast<std::uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    }
+    else {
+        id = free_nodes_.back();
+        free_nodes_.pop_back();
+    }
+    nodes_[id] = Node{
+        .cell = cell, .cluster = cluster_of(cell), .partner = id, .edges = {}};
+    cluster_nodes_[nodes_[id]->cluster].push_back(id);
+    return id;
+}
+
+void Hpa_planner::clear_border(int cluster, Side side)
+{
+    auto &border = border_nodes_[(cluster * 2) + static_cast<int>(side)];
+    for (auto id : border) {
+        std::erase(cluster_nodes_[nodes_[id]->cluster], id);
+        nodes_[id].reset();
+        free_nodes_.push_back(id);
+    }
+    border.clear();
+}
+
+void Hpa_planner::scan_border(int cluster, Side side)
+{
+    auto const cx = cluster % clusters_x_;
+    auto const cz = cluster / clusters_x_;
+    glm::ivec2 origin(cx * cluster_size, cz * cluster_size);
+    glm::ivec2 across;
+    glm::ivec2 along;
+    int length{};
+    if (side == Side::east) {
+        if (cx + 1 == clusters_x_) {
+            return;
+        }
+        origin.x += cluster_size - 1;
+        across = {1, 0};
+        along = {0, 1};
+        length = std::min(cluster_size, height_ - origin.y);
+    }
+    else {
+        if (cz + 1 == clusters_z_) {
+            return;
+        }
+        origin.y += cluster_size - 1;
+        across = {0, 1};
+        along = {1, 0};
+        length = std::min(cluster_size, width_ - origin.x);
+    }
+
+    auto &border = border_nodes_[(cluster * 2) + static_cast<int>(side)];
+    auto open = [&](int i) {
+        auto const c = origin + (along * i);
+        return is_passable(c) && is_passable(c + across);
+    };
+    auto link = [&](int i) {
+        auto const c = origin + (along * i);
+        auto const a = add_node(c);
+        auto const b = add_node(c + across);
+        nodes_[a]->partner = b;
+        nodes_[b]->partner = a;
+        border.push_back(a);
+        border.push_back(b);
+    };
+    for (int i{}; i < length;) {
+        if (!open(i)) {
+            ++i;
+            continue;
+        }
+        auto end = i;
+        while (end < length && open(end)) {
+            ++end;
+        }
+        if (end - i < long_entrance) {
+            link((i + end - 1) / 2);
+        }
+        else {
+            link(i);
+            link(end - 1);
+        }
+        i = end;
+    }
+}
+
+void Hpa_planner::link_cluster(int cluster)
+{
+    auto const &ids = cluster_nodes_[cluster];
+    std::vector<std::uint32_t> costs;
+    for (auto id : ids) {
+        auto &node = *nodes_[id];
+        node.edges.clear();
+        search_cluster(node.cell, costs);
+        for (auto other : ids) {
+            auto const cost = costs[local_index(nodes_[other]->cell)];
+            if (other != id && cost != unreachable) {
+                node.edges.push_back({.to = other, .cost = cost});
+            }
+        }
+    }
+}
+
+void Hpa_planner::search_cluster(glm::ivec2 from,
+                                 std::vector<std::uint32_t> &costs,
+                                 std::vector<std::uint8_t> *parents) const
+{
+    glm::ivec2 const lo(from.x / cluster_size * cluster_size,
+                        from.y / cluster_size * cluster_size);
+    glm::ivec2 const hi(std::min(lo.x + cluster_size, width_),
+                        std::min(lo.y + cluster_size, height_));
+    auto inside = [&](glm::ivec2 c) {
+        return lo.x <= c.x && c.x < hi.x && lo.y <= c.y && c.y < hi.y &&
+               is_passable(c);
+    };
+
+    constexpr auto cells = std::size_t{cluster_size} * cluster_size;
+    costs.assign(cells, unreachable);
+    if (parents != nullptr) {
+        parents->assign(cells, no_step);
+    }
+    Min_heap<std::pair<std::uint32_t, std::uint32_t>> open;
+    costs[local_index(from)] = 0;
+    open.emplace(0, local_index(from));
+    while (!open.empty()) {
+        auto const [cost, i] = open.top();
+        open.pop();
+        if (cost != costs[i]) {
+            continue;
+        }
+        glm::ivec2 const cell(lo.x + static_cast<int>(i % cluster_size),
+                              lo.y + static_cast<int>(i / cluster_size));
+        for (std::uint8_t s{}; s != no_step; ++s) {
+            auto const d = steps[s].offset;
+            if (!inside(cell + d) ||
+                (d.x != 0 && d.y != 0 &&
+                 (!inside({cell.x + d.x, cell.y}) ||
+                  !inside({cell.x, cell.y + d.y})))) {
+                continue;
+            }
+            auto const j = local_index(cell + d);
+            if (cost + steps[s].cost < costs[j]) {
+                costs[j] = cost + steps[s].cost;
+                if (parents != nullptr) {
+                    (*parents)[j] = s;
+                }
+                open.emplace(costs[j], static_cast<std::uint32_t>(j));
+            }
+        }
+    }
+}
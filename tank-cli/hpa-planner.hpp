@@ -0,0 +1,143 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stop_token>
+#include <tank-cli/chunked-grid.hpp>
+#include <tank-cli/map.hpp>
+#include <thread>
+#include <vector>
+
+// Hierarchical path planner (HPA*) for many units with distinct goals.
+//
+// The grid is split into square clusters. Where a run of movable cells crosses
+// the border between two clusters, a pair of abstract nodes (one on either
+// side) forms an entrance, and the nodes inside a cluster are linked by the
+// cost of the shortest path between them within the cluster. A query only
+// searches within the start and goal clusters plus this abstract graph; the
+// legs of the abstract path are refined into cells when a unit needs them.
+//
+// The planner keeps its own copy of the passable cells, chunked like the map's
+// grids, so queries can run on other threads while the game goes on. Terrain
+// changes are patched in from Map::dirty_since(), rebuilding only the clusters
+// they touch. Batches of queries are answered in turn by one worker thread,
+// which the destructor stops and joins.
+class Hpa_planner {
+  public:
+    static constexpr int cluster_size{16};
+    // Costs are in tenths of a cell: 10 per orthogonal step, 14 per diagonal.
+    static constexpr std::uint32_t unreachable{0xFFFF'FFFF};
+
+    struct Query {
+        glm::ivec2 start;
+        glm::ivec2 goal;
+    };
+
+    // Consecutive waypoints are either adjacent cells or in the same cluster,
+    // see refine().
+    struct Path {
+        std::vector<glm::ivec2> waypoints;
+        std::uint32_t cost;
+    };
+
+    explicit Hpa_planner(Map const &map);
+
+    /// @brief Catches up with the terrain changes of `map`. Waits for the
+    /// queries in flight.
+    void patch(Map const &map);
+
+    /// @brief Thread-safe. Empty if either end isn't movable or the goal
+    /// can't be reached.
+    [[nodiscard]] std::optional<Path> find(Query query) const;
+
+    /// @brief The cells after `from` up to and including `to`, two
+    /// consecutive waypoints of a Path. Thread-safe. Empty if the terrain
+    /// changed in between and the leg is blocked now.
+    [[nodiscard]] std::vector<glm::ivec2> refine(glm::ivec2 from,
+                                                 glm::ivec2 to) const;
+
+    /// @brief Queues `queries` for the worker, which answers them in order.
+    /// Batches still queued when the planner is destroyed are dropped: their
+    /// futures throw std::future_error (broken promise).
+    [[nodiscard]] std::future<std::vector<std::optional<Path>>>
+    submit(std::vector<Query> queries) const;
+
+    /// @brief Abstract nodes currently in the graph.
+    [[nodiscard]] std::size_t node_count() const;
+
+  private:
+    struct Edge {
+        std::uint32_t to;
+        std::uint32_t cost;
+    };
+
+    struct Node {
+        glm::ivec2 cell;
+        int cluster;
+        std::uint32_t partner; // The other side of the entrance
+        std::vector<Edge> edges; // To the nodes of the same cluster
+    };
+
+    // The border a cluster shares with its east or south neighbour.
+    enum class Side : std::uint8_t { east, south };
+
+    struct Batch {
+        std::vector<Query> queries;
+        std::promise<std::vector<std::optional<Path>>> paths;
+    };
+
+    int width_;
+    int height_;
+    int clusters_x_;
+    int clusters_z_;
+    std::uint64_t revision_;
+    Chunked_grid<std::uint8_t> passable_;
+    std::vector<std::optional<Node>> nodes_;
+    std::vector<std::uint32_t> free_nodes_;
+    std::vector<std::vector<std::uint32_t>> cluster_nodes_;
+    // Entrance nodes of each border, at cluster * 2 + side.
+    std::vector<std::vector<std::uint32_t>> border_nodes_;
+    mutable std::shared_mutex mutex_;
+    mutable std::mutex batches_mutex_;
+    mutable std::condition_variable_any batches_ready_;
+    mutable std::deque<Batch> batches_;
+    // Last, so it's joined before anything it uses goes.
+    mutable std::jthread worker_;
+
+    [[nodiscard]] bool is_passable(glm::ivec2 cell) const
+    {
+        return 0 <= cell.x && cell.x < width_ && 0 <= cell.y &&
+               cell.y < height_ && passable_.get(cell.x, cell.y) != 0;
+    }
+
+    [[nodiscard]] int cluster_of(glm::ivec2 cell) const
+    {
+        return (cell.y / cluster_size * clusters_x_) + (cell.x / cluster_size);
+    }
+
+    void copy_terrain(Map const &map, glm::ivec2 lo, glm::ivec2 hi);
+    // The worker's loop, answering batches until asked to stop.
+    void work(std::stop_token const &stop) const;
+    std::uint32_t add_node(glm::ivec2 cell);
+    void clear_border(int cluster, Side side);
+    void scan_border(int cluster, Side side);
+    void link_cluster(int cluster);
+
+    // Path costs from `from` to every cell of its cluster, indexed by cell
+    // within the cluster. `parents`, if given, receives the step taken into
+    // each cell.
+    void search_cluster(glm::ivec2 from, std::vector<std::uint32_t> &costs,
+                        std::vector<std::uint8_t> *parents = nullptr) const;
+    [[nodiscard]] std::size_t local_index(glm::ivec2 cell) const
+    {
+        return (static_cast<std::size_t>(cell.y % cluster_size) *
+                cluster_size) +
+               (cell.x % cluster_size);
+    }
+};
@@ -11,6 +11,7 @@
 #include <tank-cli/config.hpp>
 #include <tank-cli/ecs/world.hpp>
 #include <tank-cli/glfw.hpp>
+#include <tank-cli/map-loader.hpp>
 #include <tank-cli/map.hpp>
 #include <tank-cli/mesh.hpp>
 #include <tank-cli/motion.hpp>
@@ -19,35 +20,6 @@
 #include <tank-cli/time.hpp>
 #include <tank-cli/window.hpp>
 
-// Data (models) BEGIN--------------------
-std::vector<glm::vec3> bullet_vertices = {
-    {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, -0.5f},
-    {-0.5f, 0.5f, -0.5f},  {-0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, 0.5f},
-    {0.5f, 0.5f, 0.5f},    {-0.5f, 0.5f, 0.5f}};
-
-std::vector<uint32_t> bullet_indices = {
-    0, 1, 2, 2, 3, 0, // front face
-    4, 5, 6, 6, 7, 4, // back face
-    7, 3, 0, 0, 4, 7, // left face
-    6, 2, 1, 1, 5, 6, // right face
-    0, 1, 5, 5, 4, 0, // bottom face
-    3, 2, 6, 6, 7, 3  // top face
-};
-
-// 厚度
-float h = 3.0F;
-std::vector<glm::vec3> tank_vertices = {
-    {6, h, 3}, {-6, h, 3}, {6, h, -3}, {-6, h, -3}, {0, h, 1},  {0, h, -1},
-    {9, h, 1}, {9, h, -1}, {6, 0, 3},  {-6, 0, 3},  {6, 0, -3}, {-6, 0, -3},
-    {0, 0, 1}, {0, 0, -1}, {9, 0, 1},  {9, 0, -1}};
-std::vector<uint32_t> tank_indices = {
-    0,  1,  2,  1,  3,  2,  4,  5, 6,  5,  7, 6, 10, 9,  8, 10, 11, 9,
-    14, 13, 12, 14, 15, 13, 8,  9, 0,  0,  9, 1, 9,  11, 1, 1,  11, 3,
-    11, 10, 3,  3,  10, 2,  10, 8, 2,  2,  8, 0, 12, 14, 4, 4,  14, 6,
-    13, 5,  15, 15, 5,  7,  12, 4, 13, 13, 4, 5, 14, 15, 6, 6,  15, 7,
-};
-// Data END----------------
-
 int main(int argc, char **argv)
 {
     using namespace std::chrono_literals;
@@ -74,13 +46,8 @@ int main(int argc, char **argv)
         glEnable(GL_DEPTH_TEST);
         glClearColor(0.2, 0.2, 0.2, 1);
 
-        Mesh tank(tank_vertices, tank_indices);
-        Mesh bullet(bullet_vertices, bullet_indices);
-
-        constexpr int width = 80;
-        constexpr int height = 60;
 #ifndef USE_ECS
-        Map map(width + 1, height + 1);
+        Map map = Map_loader::load("map1.txt");
 #else
         Map &map = systems::Resources::map();
 #endif
@@ -143,22 +110,13 @@ int main(int argc, char **argv)
             barrier.render(env_shader);
         };
 
-        map.add_barrier({.start = {0, 0}, .end = {width, 0}});
-        map.add_barrier({.start = {width, 0}, .end = {width, height}});
-        map.add_barrier({.start = {width, height}, .end = {0, height}});
-        map.add_barrier({.start = {0, height}, .end = {0, 0}});
-        map.add_barrier(
-            {.start = {width / 3, 0}, .end = {width / 3, height / 3 * 2}});
-        map.add_barrier({.start = {width / 3 * 2, height / 3},
-                         .end = {width / 3 * 2, height}});
-
         std::unordered_map<int, bool> key_pressing;
 #endif
 
         auto start_time = Clock::now();
         auto last_frame = Clock::now();
 
-        World world;
+        World world(config.ecs_storage);
 
         std::size_t tick{};
         while (!window.should_close()) {
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tank-cli/map-loader.hpp>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::array<char, 8> cooked_magic{'T', 'A', 'N', 'K',
+                                           'M', 'A', 'P', 0};
+
+// Layout of a cooked map: the header, `barrier_count` barriers, then the Cell
+// grid and the distance grid. A grid is its chunks in row-major order, each a
+// flag byte followed by either one value (uniform) or chunk_cells values.
+struct Cooked_header {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t barrier_count;
+};
+
+struct Cooked_barrier {
+    std::int32_t x0;
+    std::int32_t z0;
+    std::int32_t x1;
+    std::int32_t z1;
+};
+
+// Read-only memory mapping of a whole file.
+class Mapped_file {
+  public:
+    explicit Mapped_file(fs::path const &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error("failed to open " + path.string());
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) == -1) {
+            ::close(fd);
+            throw std::runtime_error("failed to stat " + path.string());
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ != 0) {
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (data_ == MAP_FAILED) {
+            throw std::runtime_error("failed to map " + path.string());
+        }
+    }
+    Mapped_file(Mapped_file const &) = delete;
+    Mapped_file(Mapped_file &&) = delete;
+    Mapped_file &operator=(Mapped_file const &) = delete;
+    Mapped_file &operator=(Mapped_file &&) = delete;
+    ~Mapped_file()
+    {
+        if (data_ != nullptr && data_ != MAP_FAILED) {
+            ::munmap(data_, size_);
+        }
+    }
+
+    [[nodiscard]] std::byte const *data() const
+    {
+        return static_cast<std::byte const *>(data_);
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return size_;
+    }
+
+  private:
+    void *data_{};
+    std::size_t size_{};
+};
+
+enum class Cooked_chunk : std::uint8_t { uniform, dense };
+
+template <typename T, typename Write>
+void write_grid(Chunked_grid<T> const &grid, Write &&write)
+{
+    for (int cz{}; cz != grid.chunks_z(); ++cz) {
+        for (int cx{}; cx != grid.chunks_x(); ++cx) {
+            auto const cells = grid.chunk_cells_of(cx, cz);
+            auto const flag =
+                cells.empty() ? Cooked_chunk::uniform : Cooked_chunk::dense;
+            write(&flag, sizeof(flag));
+            if (cells.empty()) {
+                auto const value = grid.chunk_uniform(cx, cz);
+                write(&value, sizeof(value));
+            }
+            else {
+                write(cells.data(), cells.size_bytes());
+            }
+        }
+    }
+}
+
+// Reads a grid written by write_grid() at `p`, advancing it. `end` bounds the
+// read, `fail` builds the exception for a malformed image.
+template <typename T, typename Fail>
+void read_grid(Chunked_grid<T> &grid, std::byte const *&p,
+               std::byte const *end, Fail &&fail)
+{
+    auto take = [&](void *out, std::size_t size) {
+        if (static_cast<std::size_t>(end - p) < size) {
+            throw fail("truncated grid");
+        }
+        std::memcpy(out, p, size);
+        p += size;
+    };
+
+    std::vector<T> cells(Chunked_grid<T>::chunk_cells);
+    for (int cz{}; cz != grid.chunks_z(); ++cz) {
+        for (int cx{}; cx != grid.chunks_x(); ++cx) {
+            Cooked_chunk flag{};
+            take(&flag, sizeof(flag));
+            if (flag == Cooked_chunk::uniform) {
+                T value{};
+                take(&value, sizeof(value));
+                grid.assign_chunk(cx, cz, value, {});
+            }
+            else if (flag == Cooked_chunk::dense) {
+                take(cells.data(), cells.size() * sizeof(T));
+                grid.assign_chunk(cx, cz, T{}, cells);
+            }
+            else {
+                throw fail("bad chunk flag");
+            }
+        }
+    }
+}
+
+} // namespace
+
+Map Map_loader::load_text(fs::path const &path)
+{
+    std::ifstream file(path);
+    if (!fs::exists(path)) {
+        throw std::runtime_error("failed to open map " + path.string() +
+                                 ": file doesn't exist");
+    }
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open map " + path.string() +
+                                 ": unknown error");
+    }
+
+    std::optional<Map> map;
+    std::string line;
+    for (int line_no{1}; std::getline(file, line); ++line_no) {
+        line.erase(std::min(line.find('#'), line.size()));
+        std::istringstream iss(line);
+        if ((iss >> std::ws).eof()) {
+            continue;
+        }
+
+        auto fail = [&](std::string_view what) {
+            return std::runtime_error(std::format("invalid map {}:{}: {}",
+                                                  path.string(), line_no,
+                                                  what));
+        };
+        if (!map) {
+            int width{};
+            int height{};
+            if (!(iss >> width >> height) || width <= 0 || height <= 0) {
+                throw fail("expected \"<width> <height>\"");
+            }
+            map.emplace(width, height);
+            continue;
+        }
+
+        Barrier b{};
+        if (!(iss >> b.start.x >> b.start.y >> b.end.x >> b.end.y)) {
+            throw fail("expected \"<x0> <z0> <x1> <z1>\"");
+        }
+        if (b.start == b.end ||
+            (b.start.x != b.end.x && b.start.y != b.end.y)) {
+            throw fail("barriers must be axis-aligned and non-empty");
+        }
+        map->add_barrier(b);
+    }
+    if (!map) {
+        throw std::runtime_error("invalid map " + path.string() +
+                                 ": missing size");
+    }
+    return std::move(*map);
+}
+
+void Map_loader::cook(Map const &map, fs::path const &path)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to write cooked map " +
+                                 path.string());
+    }
+    auto write = [&file](void const *data, std::size_t size) {
+        file.write(static_cast<char const *>(data),
+                   static_cast<std::streamsize>(size));
+    };
+
+    // Removed barriers are dropped, which renumbers the others. Barrier ids
+    // only mean something within one loaded map.
+    Cooked_header header{.magic = cooked_magic,
+                         .version = cooked_version,
+                         .width = static_cast<std::uint32_t>(map.width_),
+                         .height = static_cast<std::uint32_t>(map.height_),
+                         .barrier_count = static_cast<std::uint32_t>(
+                             std::ranges::count_if(map.barriers_, [](auto &b) {
+                                 return b.has_value();
+                             }))};
+    write(&header, sizeof(header));
+    for (auto const &b : map.barriers_) {
+        if (!b) {
+            continue;
+        }
+        Cooked_barrier cb{.x0 = b->start.x,
+                          .z0 = b->start.y,
+                          .x1 = b->end.x,
+                          .z1 = b->end.y};
+        write(&cb, sizeof(cb));
+    }
+    write_grid(map.cells_, write);
+    write_grid(map.distance2_, write);
+
+    if (!file) {
+        throw std::runtime_error("failed to write cooked map " +
+                                 path.string());
+    }
+}
+
+Map Map_loader::load_cooked(fs::path const &path)
+{
+    Mapped_file file(path);
+    auto fail = [&path](std::string_view what) {
+        return std::runtime_error(
+            std::format("invalid cooked map {}: {}", path.string(), what));
+    };
+
+    Cooked_header header;
+    if (file.size() < sizeof(header)) {
+        throw fail("truncated header");
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != cooked_magic) {
+        throw fail("bad magic");
+    }
+    if (header.version != cooked_version) {
+        throw fail(std::format("version {}, expected {}", header.version,
+                               cooked_version));
+    }
+
+    constexpr std::uint32_t max_side = std::numeric_limits<int>::max();
+    if (header.width == 0 || header.height == 0 || header.width > max_side ||
+        header.height > max_side) {
+        throw fail("bad size");
+    }
+    auto const barriers_size =
+        std::size_t{header.barrier_count} * sizeof(Cooked_barrier);
+    if (file.size() - sizeof(header) < barriers_size) {
+        throw fail("truncated barriers");
+    }
+    // Every chunk of both grids takes at least its flag and one value, so a
+    // size the file can't hold is rejected before Map allocates its chunks.
+    auto chunks_along = [](std::uint32_t cells) {
+        return (std::size_t{cells} + Chunked_grid<Cell>::chunk_mask) >>
+               Chunked_grid<Cell>::chunk_bits;
+    };
+    auto const chunks =
+        chunks_along(header.width) * chunks_along(header.height);
+    auto const min_chunk_size =
+        (2 * sizeof(Cooked_chunk)) + sizeof(Cell) + sizeof(float);
+    if ((file.size() - sizeof(header) - barriers_size) / min_chunk_size <
+        chunks) {
+        throw fail("bad size");
+    }
+
+    Map map(static_cast<int>(header.width), static_cast<int>(header.height));
+    auto const *p = file.data() + sizeof(header);
+    auto const *const end = file.data() + file.size();
+    map.barriers_.reserve(header.barrier_count);
+    for (std::uint32_t i{}; i != header.barrier_count; ++i) {
+        Cooked_barrier cb;
+        std::memcpy(&cb, p, sizeof(cb));
+        p += sizeof(cb);
+        Barrier const b{.start = {cb.x0, cb.z0}, .end = {cb.x1, cb.z1}};
+        if (b.start == b.end ||
+            (b.start.x != b.end.x && b.start.y != b.end.y)) {
+            throw fail("bad barrier");
+        }
+        // The wall counts aren't cooked, they're cheap to recount. The cells
+        // this touches are overwritten by the cooked grid right after.
+        map.add_wall_refs(b, 1);
+        map.barriers_.emplace_back(b);
+    }
+    read_grid(map.cells_, p, end, fail);
+    read_grid(map.distance2_, p, end, fail);
+    if (p != end) {
+        throw fail("trailing bytes");
+    }
+    return map;
+}
+
+Map Map_loader::load(fs::path const &text_path)
+{
+    auto const cooked = cooked_path(text_path);
+    if (fs::exists(cooked) &&
+        fs::last_write_time(cooked) >= fs::last_write_time(text_path)) {
+        try {
+            return load_cooked(cooked);
+        }
+        catch (std::exception const &e) {
+            spdlog::warn("{}, cooking it again", e.what());
+        }
+    }
+
+    auto map = load_text(text_path);
+    try {
+        cook(map, cooked);
+    }
+    catch (std::exception const &e) {
+        spdlog::warn(e.what());
+    }
+    return map;
+}
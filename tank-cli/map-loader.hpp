@@ -0,0 +1,37 @@
+#pragma once
+
+#include <filesystem>
+#include <tank-cli/map.hpp>
+
+namespace fs = std::filesystem;
+
+// Reads maps from disk.
+//
+// The text format is a line "<width> <height>" (in cells) followed by one
+// axis-aligned barrier per line, "<x0> <z0> <x1> <z1>". Everything after '#' on
+// a line is a comment.
+//
+// Parsing means rasterizing every barrier, so a map can also be "cooked" into a
+// versioned binary image of the rasterized grid. Loading that image is a memory
+// map and a copy per chunk, without any rasterization. Uniform chunks are
+// stored as a single value, so open space costs next to nothing on disk too.
+class Map_loader {
+  public:
+    static constexpr std::uint32_t cooked_version{2};
+
+    static Map load_text(fs::path const &path);
+
+    static void cook(Map const &map, fs::path const &path);
+
+    static Map load_cooked(fs::path const &path);
+
+    /// @brief Loads the cooked image next to the text map if it is up to
+    /// date, otherwise parses the text map and (re)cooks it.
+    static Map load(fs::path const &text_path);
+
+    /// @brief Where load() keeps the cooked image of `text_path`.
+    static fs::path cooked_path(fs::path const &text_path)
+    {
+        return fs::path(text_path).replace_extension(".tkmap");
+    }
+};
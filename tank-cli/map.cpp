@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <format>
+#include <limits>
 #include <print>
 #include <random>
 #include <ranges>
+#include <stdexcept>
 #include <tank-cli/map.hpp>
 #include <tank-cli/motion.hpp>
 #include <tank-cli/player.hpp>
@@ -9,8 +15,12 @@
 
 Map::Map(int width, int height)
     : width_(width), height_(height),
-      terrain_(width, std::vector<Terrain>(height, Terrain::movable)),
-      is_x_axis_(width, std::vector<bool>(height, false)), tank_radius_(1),
+      cells_(width, height, Cell{}),
+      distance2_(width, height,
+                 static_cast<float>(Cell::max_clearance * Cell::max_clearance)),
+      wall_refs_(width, height, 0), occupants_(width, height, 0),
+      connectivity_(width, height),
+      tank_radius_(1),
       bullet_radius_(0)
 {
 }
@@ -20,72 +30,230 @@ void Map::add_player(Player &&player)
     players_.push_back(std::move(player));
 }
 
-//    --------------
-//  -/              \-
-// |   x==========x   |
-//  -\              /-
-//    --------------
-void Map::add_barrier(Barrier barrier)
+// Only the wall cells are rasterized. Which cells around it are too close for
+// a unit follows from the distance field, see update_distance_field: those
+// within tank_radius_ of a wall cell. With a radius of 1 that's the cells on
+// both sides of the wall and, unlike the old hand-rasterized padding, the cell
+// past each end along the wall axis too, so bots can't squeeze past the ends.
+//
+//      ------------
+//     -x==========x-
+//      ------------
+Barrier_id Map::add_barrier(Barrier barrier)
+{
+    add_wall_refs(barrier, 1);
+    update_distance_field({std::min(barrier.start.x, barrier.end.x),
+                           std::min(barrier.start.y, barrier.end.y)},
+                          {std::max(barrier.start.x, barrier.end.x),
+                           std::max(barrier.start.y, barrier.end.y)});
+
+    barriers_.emplace_back(barrier);
+    return static_cast<Barrier_id>(barriers_.size() - 1);
+}
+
+void Map::remove_barrier(Barrier_id id)
+{
+    if (id >= barriers_.size() || !barriers_[id]) {
+        throw std::out_of_range(std::format("no barrier {}", id));
+    }
+    auto const barrier = *barriers_[id];
+    barriers_[id].reset();
+
+    add_wall_refs(barrier, -1);
+    update_distance_field({std::min(barrier.start.x, barrier.end.x),
+                           std::min(barrier.start.y, barrier.end.y)},
+                          {std::max(barrier.start.x, barrier.end.x),
+                           std::max(barrier.start.y, barrier.end.y)});
+}
+
+// A cell shared by several barriers keeps the axis of the last one added to it.
+void Map::add_wall_refs(Barrier const &barrier, int delta)
 {
     auto dir = barrier.end - barrier.start;
     auto const len = std::abs(dir.x) + std::abs(dir.y);
     dir /= len;
 
-    auto ortho = dir;
-    std::swap(ortho.x, ortho.y);
-
-    // Circle in endpoints
-    //    -            -
-    //  -/|            |\-
-    // |--|            |--|
-    //  -\|            |/-
-    //    -            -
-    std::vector endpoints{barrier.start, barrier.end};
-    for (auto endpoint : endpoints) {
-        for (int i{-tank_radius_}; i != tank_radius_ + 1; ++i) {
-            for (int j{-tank_radius_}; j != tank_radius_ + 1; ++j) {
-                if (i * i + j * j >= tank_radius_ * tank_radius_) {
-                    continue;
-                }
-                glm::ivec3 p(endpoint.x + i, 0, endpoint.y + j);
-                if (is_valid(p) && terrain_[p.x][p.z] != Terrain::wall) {
-                    terrain_[p.x][p.z] = Terrain::immovable;
-                }
+    for (int i{}; i != len + 1; ++i) {
+        auto p = barrier.start + dir * i;
+        if (!is_valid_cell(p)) {
+            continue;
+        }
+        auto const refs = wall_refs_.get(p.x, p.y) + delta;
+        wall_refs_.set(p.x, p.y, static_cast<std::uint16_t>(refs));
+
+        auto c = cells_.get(p.x, p.y);
+        if (refs == 0) {
+            // Movable for now, the distance field decides the rest.
+            c.set_terrain(Terrain::movable);
+        }
+        else {
+            c.set_terrain(Terrain::wall);
+            if (delta > 0) {
+                c.set_x_axis(dir.x != 0);
             }
         }
+        cells_.set(p.x, p.y, c);
     }
+    wall_refs_.compact(std::min(barrier.start.x, barrier.end.x),
+                       std::min(barrier.start.y, barrier.end.y),
+                       std::max(barrier.start.x, barrier.end.x),
+                       std::max(barrier.start.y, barrier.end.y));
+}
 
-    // Rectangle around
-    //     ------------
-    //     ------------
-    //
-    //     ------------
-    //     ------------
-    for (int i{}; i != len + 1; ++i) {
-        auto point = barrier.start + dir * i;
-        for (int j{-tank_radius_}; j != tank_radius_ + 1; ++j) {
-            auto p_ = point + j * ortho;
-            glm::ivec3 p(p_.x, 0, p_.y);
-            if (is_valid(p) && terrain_[p.x][p.z] != Terrain::wall) {
-                terrain_[p.x][p.z] = Terrain::immovable;
-            }
+Connectivity const &Map::connectivity()
+{
+    if (connectivity_revision_ != revision_) {
+        connectivity_.build(*this);
+        connectivity_revision_ = revision_;
+    }
+    return connectivity_;
+}
+
+// The free cells are only tracked while the labels are current; a relabel
+// collects them from occupants_ anyway.
+void Map::occupy(glm::ivec2 cell)
+{
+    auto const n = occupants_.get(cell.x, cell.y);
+    occupants_.set(cell.x, cell.y, static_cast<std::uint16_t>(n + 1));
+    if (n == 0 && connectivity_revision_ == revision_) {
+        connectivity_.remove_free(cell);
+    }
+}
+
+void Map::vacate(glm::ivec2 cell)
+{
+    auto const old = occupants_.get(cell.x, cell.y);
+    if (old == 0) {
+        return; // Unbalanced call; wrapping would keep the cell taken for good
+    }
+    auto const n = static_cast<std::uint16_t>(old - 1);
+    occupants_.set(cell.x, cell.y, n);
+    if (n == 0 && connectivity_revision_ == revision_) {
+        connectivity_.add_free(cell);
+    }
+}
+
+namespace {
+
+// Squared Euclidean distance transform of a sampled 1D function, i.e. the lower
+// envelope of the parabolas rooted at every sample (Felzenszwalb and
+// Huttenlocher). `v` and `z` are scratch of size n and n + 1.
+void edt_1d(std::span<double const> f, std::span<double> d, std::span<int> v,
+            std::span<double> z)
+{
+    constexpr auto inf = std::numeric_limits<double>::infinity();
+    auto const n = static_cast<int>(f.size());
+    auto intersect = [&](int q, int p) {
+        return ((f[q] + (q * q)) - (f[p] + (p * p))) / ((2 * q) - (2 * p));
+    };
+
+    int k{};
+    v[0] = 0;
+    z[0] = -inf;
+    z[1] = inf;
+    for (int q{1}; q != n; ++q) {
+        auto s = intersect(q, v[k]);
+        while (s <= z[k]) {
+            --k;
+            s = intersect(q, v[k]);
         }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = inf;
     }
 
-    // Finally, the wall itself
-    //
-    //
-    //     x==========x
-    //
-    //
-    for (int i{}; i != len + 1; ++i) {
-        auto p_ = barrier.start + dir * i;
-        glm::ivec3 p(p_.x, 0, p_.y);
-        terrain_[p.x][p.z] = Terrain::wall;
-        is_x_axis_[p.x][p.z] = dir.x != 0;
+    k = 0;
+    for (int q{}; q != n; ++q) {
+        while (z[k + 1] < q) {
+            ++k;
+        }
+        d[q] = ((q - v[k]) * (q - v[k])) + f[v[k]];
     }
+}
+
+} // namespace
+
+// Recomputes the distance field for everything a change of walls inside
+// [lo, hi] can affect: the cells within max_clearance of the region. Those are
+// computed exactly from all the walls within max_clearance of them, with a
+// two-pass (columns, then rows) distance transform over that window. A cell
+// is movable only farther than tank_radius_ from every wall cell, the ends of
+// walls included. The recomputed cells make up the next revision's dirty
+// region.
+void Map::update_distance_field(glm::ivec2 lo, glm::ivec2 hi)
+{
+    constexpr int reach = Cell::max_clearance;
+    constexpr auto max_distance2 = static_cast<float>(reach * reach);
+    // Stand-in for "no wall": far enough to never win, small enough to keep
+    // the parabola intersections finite.
+    constexpr double far = 1e12;
 
-    barriers_.push_back(barrier);
+    auto clamp_cell = [this](glm::ivec2 c) {
+        return glm::ivec2(std::clamp(c.x, 0, width_ - 1),
+                          std::clamp(c.y, 0, height_ - 1));
+    };
+    glm::ivec2 const margin(reach, reach);
+    auto const target_lo = clamp_cell(lo - margin);
+    auto const target_hi = clamp_cell(hi + margin);
+    auto const window_lo = clamp_cell(target_lo - margin);
+    auto const window_hi = clamp_cell(target_hi + margin);
+    auto const w = window_hi.x - window_lo.x + 1;
+    auto const h = window_hi.y - window_lo.y + 1;
+    auto const n = static_cast<std::size_t>(std::max(w, h));
+
+    std::vector<double> columns(static_cast<std::size_t>(w) * h);
+    std::vector<double> f(n);
+    std::vector<double> d(n);
+    std::vector<double> z(n + 1);
+    std::vector<int> v(n);
+
+    // Pass 1: distance to the nearest wall in the same column.
+    for (int x{}; x != w; ++x) {
+        for (int y{}; y != h; ++y) {
+            auto const c = cells_.get(window_lo.x + x, window_lo.y + y);
+            f[y] = c.terrain() == Terrain::wall ? 0 : far;
+        }
+        edt_1d(std::span(f).first(h), std::span(d).first(h), v, z);
+        for (int y{}; y != h; ++y) {
+            columns[(static_cast<std::size_t>(y) * w) + x] = d[y];
+        }
+    }
+
+    // Pass 2: combine the columns along every row of the target region.
+    auto const tank_radius2 = static_cast<float>(tank_radius_ * tank_radius_);
+    for (int y{target_lo.y - window_lo.y}; y <= target_hi.y - window_lo.y;
+         ++y) {
+        std::copy_n(columns.begin() + (static_cast<std::ptrdiff_t>(y) * w), w,
+                    f.begin());
+        edt_1d(std::span(f).first(w), std::span(d).first(w), v, z);
+        for (int x{target_lo.x - window_lo.x}; x <= target_hi.x - window_lo.x;
+             ++x) {
+            glm::ivec2 const p(window_lo.x + x, window_lo.y + y);
+            auto const d2 = std::min(static_cast<float>(d[x]), max_distance2);
+            distance2_.set(p.x, p.y, d2);
+
+            auto c = cells_.get(p.x, p.y);
+            c.set_clearance(static_cast<std::uint8_t>(std::sqrt(d2)));
+            if (c.terrain() != Terrain::wall) {
+                c.set_terrain(d2 > tank_radius2 ? Terrain::movable
+                                                : Terrain::immovable);
+            }
+            cells_.set(p.x, p.y, c);
+        }
+    }
+
+    cells_.compact(target_lo.x, target_lo.y, target_hi.x, target_hi.y);
+    distance2_.compact(target_lo.x, target_lo.y, target_hi.x, target_hi.y);
+
+    // The older half goes at once, so trimming is amortized O(1) a change.
+    if (dirty_.size() == max_dirty_regions) {
+        auto const half = dirty_.begin() + (max_dirty_regions / 2);
+        forgotten_ = (half - 1)->revision;
+        dirty_.erase(dirty_.begin(), half);
+    }
+    dirty_.push_back(
+        {.revision = ++revision_, .lo = target_lo, .hi = target_hi});
 }
 
 namespace {
@@ -108,7 +276,8 @@ char terrain2display(Terrain t)
 //
 //     for (int i{}; i != height_; ++i) {
 //         for (int j{}; j != width_; ++j) {
-//             map[i][j] = terrain2display(terrain_[i][j]);
+//             map[i][j] =
+//                 terrain2display(cells_.get(j, i).terrain());
 //         }
 //     }
 //
@@ -145,16 +314,159 @@ bool Map::is_visitable(glm::vec3 pos, bool is_bullet, bool *is_x_axis) const
         return false;
     }
 
-    if (is_bullet) {
-        if (is_x_axis != nullptr) {
-            *is_x_axis = is_x_axis_[pos.x][pos.z];
+    auto const c = cell_of(pos);
+    if (is_bullet && is_x_axis != nullptr) {
+        *is_x_axis = cells_.get(c.x, c.y).x_axis();
+    }
+    return is_visitable_unchecked(c, is_bullet);
+}
+
+namespace {
+
+// Where a DDA walk from `from` to `to` starts, see Map::raycast.
+struct Dda {
+    glm::ivec2 cell;
+    glm::ivec2 step;
+    glm::vec2 t_delta; // Parameter advance per cell
+    glm::vec2 t_max;   // Parameter of the next boundary crossing
+    int steps;         // Cells to enter before reaching the end
+    float length;
+};
+
+Dda start_dda(glm::vec2 from, glm::vec2 to)
+{
+    constexpr auto inf = std::numeric_limits<float>::infinity();
+
+    auto const d = to - from;
+    glm::ivec2 const cell(std::floor(from.x), std::floor(from.y));
+    glm::ivec2 const last(std::floor(to.x), std::floor(to.y));
+    glm::vec2 const t_delta(d.x != 0 ? std::abs(1 / d.x) : inf,
+                            d.y != 0 ? std::abs(1 / d.y) : inf);
+    return {
+        .cell = cell,
+        .step = {d.x > 0 ? 1 : -1, d.y > 0 ? 1 : -1},
+        .t_delta = t_delta,
+        .t_max = {d.x > 0   ? (cell.x + 1 - from.x) * t_delta.x
+                  : d.x < 0 ? (from.x - cell.x) * t_delta.x
+                            : inf,
+                  d.y > 0   ? (cell.y + 1 - from.y) * t_delta.y
+                  : d.y < 0 ? (from.y - cell.y) * t_delta.y
+                            : inf},
+        .steps = std::abs(last.x - cell.x) + std::abs(last.y - cell.y),
+        .length = std::hypot(d.x, d.y),
+    };
+}
+
+} // namespace
+
+std::optional<Ray_hit> Map::raycast(glm::vec2 from, glm::vec2 to) const
+{
+    auto dda = start_dda(from, to);
+    auto &cell = dda.cell;
+    auto &t_max = dda.t_max;
+    for (int i{}; i != dda.steps; ++i) {
+        float t;
+        bool x_face = t_max.x < t_max.y;
+        if (x_face) {
+            cell.x += dda.step.x;
+            t = t_max.x;
+            t_max.x += dda.t_delta.x;
+        }
+        else {
+            cell.y += dda.step.y;
+            t = t_max.y;
+            t_max.y += dda.t_delta.y;
+        }
+        if (!is_valid_cell(cell) ||
+            cells_.get(cell.x, cell.y).terrain() == Terrain::wall) {
+            return Ray_hit{.t = t,
+                           .distance = t * dda.length,
+                           .cell = cell,
+                           .x_face = x_face};
         }
-        return terrain_[pos.x][pos.z] != Terrain::wall;
     }
+    return std::nullopt;
+}
+
+// Segments are walked in groups of `lanes`, each walk kept as a struct of
+// arrays and advanced one cell per round in lockstep. The step itself is
+// branch-free selects over the lanes, so the compiler can vectorize it; only
+// the wall lookups are per lane.
+void Map::raycast(std::span<Segment const> segments,
+                  std::span<std::optional<Ray_hit>> hits) const
+{
+    if (segments.size() != hits.size()) {
+        throw std::invalid_argument(
+            std::format("{} segments but {} hits", segments.size(),
+                        hits.size()));
+    }
+
+    constexpr std::size_t lanes{8};
+    for (std::size_t base{}; base < segments.size(); base += lanes) {
+        auto const n = std::min(lanes, segments.size() - base);
+        std::array<int, lanes> cell_x{};
+        std::array<int, lanes> cell_z{};
+        std::array<int, lanes> step_x{};
+        std::array<int, lanes> step_z{};
+        std::array<int, lanes> left{};
+        std::array<float, lanes> t_max_x{};
+        std::array<float, lanes> t_max_z{};
+        std::array<float, lanes> t_delta_x{};
+        std::array<float, lanes> t_delta_z{};
+        std::array<float, lanes> length{};
+        std::array<float, lanes> t{};
+        std::array<bool, lanes> x_face{};
+        std::array<bool, lanes> moved{};
+        for (std::size_t i{}; i != n; ++i) {
+            auto const dda =
+                start_dda(segments[base + i].from, segments[base + i].to);
+            cell_x[i] = dda.cell.x;
+            cell_z[i] = dda.cell.y;
+            step_x[i] = dda.step.x;
+            step_z[i] = dda.step.y;
+            left[i] = dda.steps;
+            t_max_x[i] = dda.t_max.x;
+            t_max_z[i] = dda.t_max.y;
+            t_delta_x[i] = dda.t_delta.x;
+            t_delta_z[i] = dda.t_delta.y;
+            length[i] = dda.length;
+            hits[base + i].reset();
+        }
+
+        for (bool walking{true}; walking;) {
+            for (std::size_t i{}; i != lanes; ++i) {
+                bool const live = left[i] > 0;
+                bool const x = t_max_x[i] < t_max_z[i];
+                x_face[i] = x;
+                t[i] = x ? t_max_x[i] : t_max_z[i];
+                cell_x[i] += live && x ? step_x[i] : 0;
+                cell_z[i] += live && !x ? step_z[i] : 0;
+                t_max_x[i] += live && x ? t_delta_x[i] : 0;
+                t_max_z[i] += live && !x ? t_delta_z[i] : 0;
+                left[i] -= live ? 1 : 0;
+                moved[i] = live;
+            }
 
-    // For tank
-    return terrain_[pos.x][pos.z] == Terrain::movable;
+            walking = false;
+            for (std::size_t i{}; i != n; ++i) {
+                if (!moved[i]) {
+                    continue;
+                }
+                glm::ivec2 const cell(cell_x[i], cell_z[i]);
+                if (!is_valid_cell(cell) ||
+                    cells_.get(cell.x, cell.y).terrain() == Terrain::wall) {
+                    hits[base + i] = Ray_hit{.t = t[i],
+                                             .distance = t[i] * length[i],
+                                             .cell = cell,
+                                             .x_face = x_face[i]};
+                    left[i] = 0;
+                }
+                walking = walking || left[i] > 0;
+            }
+        }
+    }
 }
+
 void Map::add_bullet(Bullet bullet)
 {
     bullets_.push_back(std::move(bullet));
@@ -292,6 +604,8 @@ void Map::render(Shader_program &shader, Shader_program &player_shader,
                  std::function<void(Barrier const &)> const &render_barrier)
 {
     for (auto const &b : barriers_) {
-        render_barrier(b);
+        if (b) {
+            render_barrier(*b);
+        }
     }
 }
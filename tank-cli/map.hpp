@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <list>
+#include <optional>
+#include <span>
 #include <spdlog/spdlog.h>
 #include <tank-cli/bullet.hpp>
+#include <tank-cli/chunked-grid.hpp>
+#include <tank-cli/connectivity.hpp>
 #include <tank-cli/player.hpp>
 #include <vector>
 
@@ -18,10 +23,93 @@ enum class Direction : std::uint8_t { horizontal, vertical };
 
 using Barrier = Line;
 
+// Index of a barrier in Map::barriers(), stable for the lifetime of the map.
+using Barrier_id = std::uint32_t;
+
+// Cells [lo, hi] (inclusive) whose terrain changed in map revision `revision`.
+struct Dirty_region {
+    std::uint64_t revision;
+    glm::ivec2 lo;
+    glm::ivec2 hi;
+};
+
 enum class Terrain : std::uint8_t { wall, immovable, movable };
 
+// Everything the map knows about one cell, packed into a byte: terrain in bits
+// 0-1, wall axis in bit 2 and clearance in bits 3-7.
+class Cell {
+  public:
+    // Clearance saturates here; farther cells are simply "far from walls".
+    static constexpr std::uint8_t max_clearance{31};
+
+    constexpr Cell()
+        : bits_(static_cast<std::uint8_t>(Terrain::movable) |
+                (max_clearance << clearance_shift))
+    {
+    }
+
+    [[nodiscard]] constexpr Terrain terrain() const
+    {
+        return static_cast<Terrain>(bits_ & terrain_mask);
+    }
+
+    constexpr void set_terrain(Terrain t)
+    {
+        bits_ = (bits_ & ~terrain_mask) | static_cast<std::uint8_t>(t);
+    }
+
+    /// @brief For walls: whether the wall runs along the x axis.
+    [[nodiscard]] constexpr bool x_axis() const
+    {
+        return (bits_ & x_axis_bit) != 0;
+    }
+
+    constexpr void set_x_axis(bool value)
+    {
+        bits_ = value ? bits_ | x_axis_bit : bits_ & ~x_axis_bit;
+    }
+
+    /// @brief Distance to the nearest wall cell in whole cells, derived from
+    /// the map's exact distance field.
+    [[nodiscard]] constexpr std::uint8_t clearance() const
+    {
+        return bits_ >> clearance_shift;
+    }
+
+    constexpr void set_clearance(std::uint8_t value)
+    {
+        value = std::min(value, max_clearance);
+        bits_ = (bits_ & ~clearance_mask) | (value << clearance_shift);
+    }
+
+    friend constexpr bool operator==(Cell, Cell) = default;
+
+  private:
+    static constexpr std::uint8_t terrain_mask{0b11};
+    static constexpr std::uint8_t x_axis_bit{0b100};
+    static constexpr int clearance_shift{3};
+    static constexpr std::uint8_t clearance_mask{0b1111'1000};
+
+    std::uint8_t bits_;
+};
+static_assert(sizeof(Cell) == 1);
+
+struct Ray_hit {
+    float t;         // Fraction of the segment travelled before the hit
+    float distance;  // Distance travelled before the hit, in cells
+    glm::ivec2 cell; // The blocking cell, possibly outside of the map
+    bool x_face;     // Whether a face perpendicular to the x axis was hit
+};
+
+// A segment on the xz plane, for the batched Map::raycast.
+struct Segment {
+    glm::vec2 from;
+    glm::vec2 to;
+};
+
 class Map {
     friend class Player;
+    friend class Map_loader;
     friend int main(int argc, char **argv);
 
   public:
@@ -32,7 +120,13 @@ class Map {
                 std::function<void(Barrier const &)> const &render_barrier);
 
     /// @brief Add barrier to the map
-    void add_barrier(Barrier barrier);
+    Barrier_id add_barrier(Barrier barrier);
+
+    /// @brief Removes a barrier added before. Only the cells it covered and
+    /// the distance field around them are recomputed; cells still covered by
+    /// another barrier stay walls.
+    /// @throws std::out_of_range if `id` isn't a live barrier.
+    void remove_barrier(Barrier_id id);
 
     void add_bullet(Bullet bullet);
 
@@ -40,6 +134,78 @@ class Map {
 
     void display_terrain() const;
 
+    /// @brief Indexed by Barrier_id, removed barriers are empty.
+    [[nodiscard]] std::vector<std::optional<Barrier>> const &barriers() const
+    {
+        return barriers_;
+    }
+
+    /// @brief Bumped on every change of terrain.
+    [[nodiscard]] std::uint64_t revision() const
+    {
+        return revision_;
+    }
+
+    /// @brief Connected components of the movable cells, relabelled on first
+    /// use after the terrain changed. Not const, since it may relabel: it
+    /// mustn't be called while workers share the map.
+    [[nodiscard]] Connectivity const &connectivity();
+
+    /// @brief Whether a unit can get from `a` to `b`. No bounds check. May
+    /// relabel, see connectivity().
+    [[nodiscard]] bool same_component(glm::ivec2 a, glm::ivec2 b)
+    {
+        auto const label = connectivity().label(a);
+        return label != Connectivity::none && label == connectivity_.label(b);
+    }
+
+    /// @brief Units standing in `cell`. No bounds check.
+    [[nodiscard]] std::uint16_t occupants(glm::ivec2 cell) const
+    {
+        return occupants_.get(cell.x, cell.y);
+    }
+
+    /// @brief A unit entered `cell`, which stops being free. No bounds check.
+    void occupy(glm::ivec2 cell);
+
+    /// @brief A unit left `cell`. Does nothing if it has no occupant. No
+    /// bounds check.
+    void vacate(glm::ivec2 cell);
+
+    /// @brief Occupies and returns up to `n` distinct free cells, drawn
+    /// uniformly from the largest component with `random() % k`, so the
+    /// units placed there can all reach each other. O(n).
+    template <typename Random>
+    std::vector<glm::ivec2> take_free_cells(std::size_t n, Random &&random)
+    {
+        auto const largest = connectivity().largest();
+        if (largest == Connectivity::none) {
+            return {};
+        }
+        auto cells = connectivity_.take_free(largest, n, random);
+        for (auto c : cells) {
+            occupants_.set(
+                c.x, c.y,
+                static_cast<std::uint16_t>(occupants_.get(c.x, c.y) + 1));
+        }
+        return cells;
+    }
+
+    /// @brief The regions changed after `revision`, oldest first. Caches of
+    /// the terrain remember revision() and patch just these. Only the latest
+    /// max_dirty_regions are kept; nullopt if some of those asked for have
+    /// been forgotten, and the cache must be rebuilt.
+    [[nodiscard]] std::optional<std::span<Dirty_region const>>
+    dirty_since(std::uint64_t revision) const
+    {
+        if (revision < forgotten_) {
+            return std::nullopt;
+        }
+        auto it = std::ranges::upper_bound(dirty_, revision, {},
+                                           &Dirty_region::revision);
+        return std::span<Dirty_region const>{it, dirty_.end()};
+    }
+
     [[nodiscard]] int height() const
     {
         return height_;
@@ -61,20 +227,99 @@ class Map {
     }
 
     [[nodiscard]] bool is_valid(glm::vec3 pos) const;
+    [[nodiscard]] bool is_valid_cell(glm::ivec2 cell) const
+    {
+        return 0 <= cell.x && cell.x < width_ && 0 <= cell.y &&
+               cell.y < height_;
+    }
+
     [[nodiscard]] bool is_visitable(glm::vec3 pos, bool is_bullet = false,
                                     bool *is_x_axis = nullptr) const;
 
+    /// @brief Whether a unit of `radius` cells can stand at `pos`, i.e. no
+    /// wall cell is within `radius` of it. One lookup and one compare.
+    [[nodiscard]] bool is_visitable_disc(glm::vec3 pos, float radius) const
+    {
+        return is_valid(pos) && distance2(cell_of(pos)) > radius * radius;
+    }
+
+    /// @brief Squared distance from `cell` to the nearest wall cell,
+    /// saturated at Cell::max_clearance squared. No bounds check.
+    [[nodiscard]] float distance2(glm::ivec2 cell) const
+    {
+        return distance2_.get(cell.x, cell.y);
+    }
+
+    /// @brief Fast path of is_visitable for cells already known to be
+    /// valid: no bounds check, no float conversion.
+    [[nodiscard]] bool is_visitable_unchecked(glm::ivec2 cell,
+                                              bool is_bullet = false) const
+    {
+        auto const c = cells_.get(cell.x, cell.y);
+        return is_bullet ? c.terrain() != Terrain::wall
+                         : c.terrain() == Terrain::movable;
+    }
+
+    /// @brief The cell containing `pos`, which must be valid.
+    [[nodiscard]] static glm::ivec2 cell_of(glm::vec3 pos)
+    {
+        return {static_cast<int>(pos.x), static_cast<int>(pos.z)};
+    }
+
+    /// @brief No bounds check.
+    [[nodiscard]] Cell cell(glm::ivec2 cell) const
+    {
+        return cells_.get(cell.x, cell.y);
+    }
+
+    /// @brief All the cells, for walking them chunk by chunk.
+    [[nodiscard]] Chunked_grid<Cell> const &cells() const
+    {
+        return cells_;
+    }
+
+    /// @brief Walks the cells crossed by the segment `from`-`to` on the xz
+    /// plane (Amanatides-Woo DDA) and returns the first wall cell entered.
+    /// Leaving the map counts as hitting a wall. The cell containing `from`
+    /// is never reported, so a segment starting inside a wall can get out.
+    [[nodiscard]] std::optional<Ray_hit> raycast(glm::vec2 from,
+                                                 glm::vec2 to) const;
+
+    /// @brief raycast() for every segment, `hits[i]` being the result for
+    /// `segments[i]`; a segment without a hit has a clear line of sight.
+    /// Only reads the map, so workers may share it while nothing modifies it.
+    /// @throws std::invalid_argument if the spans differ in size.
+    void raycast(std::span<Segment const> segments,
+                 std::span<std::optional<Ray_hit>> hits) const;
+
   private:
     int width_;
     int height_;
-    std::vector<std::vector<Terrain>> terrain_;
-    std::vector<std::vector<bool>> is_x_axis_;
-    std::vector<Barrier> barriers_;
+    // Both grids are chunked, so open floor costs (almost) nothing.
+    Chunked_grid<Cell> cells_;
+    // Squared distance to the nearest wall cell.
+    Chunked_grid<float> distance2_;
+    // How many barriers cover each cell; a cell is a wall while it's nonzero.
+    Chunked_grid<std::uint16_t> wall_refs_;
+    std::vector<std::optional<Barrier>> barriers_;
+    std::uint64_t revision_{};
+    static constexpr std::size_t max_dirty_regions{1024};
+    std::vector<Dirty_region> dirty_; // See dirty_since()
+    std::uint64_t forgotten_{}; // Latest revision dropped from dirty_
+    // Units per cell, kept by whoever moves them (see occupy()).
+    Chunked_grid<std::uint16_t> occupants_;
+    Connectivity connectivity_;
+    std::optional<std::uint64_t> connectivity_revision_;
     int tank_radius_;
     int bullet_radius_;
     std::vector<Player> players_;
     std::list<Bullet> bullets_;
 
+    // Adds `delta` to the wall count of every cell of `barrier`, turning cells
+    // into walls and back as their count leaves and reaches zero.
+    void add_wall_refs(Barrier const &barrier, int delta);
+    void update_distance_field(glm::ivec2 lo, glm::ivec2 hi);
+
     void render_circle(std::vector<std::vector<char>> &map, glm::vec2 pos,
                        int radius, char ch) const;
     void render_line(std::vector<std::vector<char>> &map, glm::vec2 u,
@@ -3,8 +3,9 @@
 #include <cassert>
 #include <cstdint>
 #include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <span>
 #include <tank-cli/shader-program.hpp>
-#include <vector>
 
 // For rendering, containing vertices of models, vao, vbo and ebo.
 //
@@ -14,16 +15,18 @@ class Mesh {
     Mesh(Mesh const &) = delete;
     Mesh(Mesh &&other) noexcept
         : vao_(other.vao_), vbo_(other.vbo_), ebo_(other.ebo_),
-          vertices_(std::move(other.vertices_)),
-          indices_(std::move(other.indices_))
+          index_count_(other.index_count_)
 
     {
         other.vao_ = other.vbo_ = other.ebo_ = -1U;
     }
     Mesh &operator=(Mesh const &) = delete;
     Mesh &operator=(Mesh &&) = delete;
-    Mesh(std::vector<float> vertices, std::vector<std::uint32_t> indices)
-        : vertices_(std::move(vertices)), indices_(std::move(indices))
+    // The data is uploaded straight from the given spans, nothing is copied on
+    // the CPU side. The GPU buffers are the only copy the Mesh keeps.
+    Mesh(std::span<float const> vertices,
+         std::span<std::uint32_t const> indices)
+        : index_count_(indices.size())
     {
         glGenVertexArrays(1, &vao_);
         glBindVertexArray(vao_);
@@ -32,15 +35,14 @@ class Mesh {
         glGenBuffers(1, &vbo_);
         glBindBuffer(GL_ARRAY_BUFFER, vbo_);
         glBufferData(GL_ARRAY_BUFFER,
-                     static_cast<GLsizeiptr>(vertices_.size() * sizeof(float)),
-                     vertices_.data(), GL_STATIC_DRAW);
+                     static_cast<GLsizeiptr>(vertices.size_bytes()),
+                     vertices.data(), GL_STATIC_DRAW);
 
         glGenBuffers(1, &ebo_);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-        glBufferData(
-            GL_ELEMENT_ARRAY_BUFFER,
-            static_cast<GLsizeiptr>(indices_.size() * sizeof(std::uint32_t)),
-            indices_.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                     static_cast<GLsizeiptr>(indices.size_bytes()),
+                     indices.data(), GL_STATIC_DRAW);
 
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float),
                               nullptr);
@@ -59,20 +61,17 @@ class Mesh {
                 std::format("Mesh::Mesh OpenGL error: {}", err));
         }
     }
-    Mesh(std::vector<glm::vec3> vertices, std::vector<std::uint32_t> indices)
+    Mesh(std::span<glm::vec3 const> vertices,
+         std::span<std::uint32_t const> indices)
         : Mesh(
-              // Converts to std::vector<float>
-              [&vertices]() {
-                  std::vector<float> verts(vertices.size() * 3);
-                  for (int i{}; i != vertices.size(); ++i) {
-                      verts[(3 * i) + 0] = vertices[i].x;
-                      verts[(3 * i) + 1] = vertices[i].y;
-                      verts[(3 * i) + 2] = vertices[i].z;
-                  }
-                  return verts;
-              }(),
-              std::move(indices))
+              // glm::vec3 is three tightly packed floats, so reinterpret
+              // instead of converting.
+              std::span<float const>(
+                  reinterpret_cast<float const *>(vertices.data()),
+                  vertices.size() * 3),
+              indices)
     {
+        static_assert(sizeof(glm::vec3) == 3 * sizeof(float));
     }
 
     ~Mesh()
@@ -94,7 +93,7 @@ class Mesh {
                       ebo_);
         shader.use_program();
         glBindVertexArray(vao_);
-        glDrawElements(GL_TRIANGLES, static_cast<GLint>(indices_.size()),
+        glDrawElements(GL_TRIANGLES, static_cast<GLint>(index_count_),
                        GL_UNSIGNED_INT, nullptr);
         glBindVertexArray(0);
 
@@ -105,14 +104,9 @@ class Mesh {
         }
     }
 
-    [[nodiscard]] auto const &vertices() const
+    [[nodiscard]] std::size_t index_count() const
     {
-        return vertices_;
-    }
-
-    [[nodiscard]] auto const &indices() const
-    {
-        return indices_;
+        return index_count_;
     }
 
   private:
@@ -121,6 +115,5 @@ class Mesh {
     GLuint vao_{-1U};
     GLuint vbo_{-1U};
     GLuint ebo_{-1U};
-    std::vector<float> vertices_;
-    std::vector<std::uint32_t> indices_;
+    std::size_t index_count_{};
 };
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// Z-order curve: cells close on the grid get close keys, mostly.
+
+/// @brief Spreads the bits of `v` to the even bits of the result.
+[[nodiscard]] constexpr std::uint64_t morton_spread(std::uint32_t v)
+{
+    std::uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000'FFFF'0000'FFFFULL;
+    x = (x | (x << 8)) & 0x00FF'00FF'00FF'00FFULL;
+    x = (x | (x << 4)) & 0x0F0F'0F0F'0F0F'0F0FULL;
+    x = (x | (x << 2)) & 0x3333'3333'3333'3333ULL;
+    x = (x | (x << 1)) & 0x5555'5555'5555'5555ULL;
+    return x;
+}
+
+/// @brief Interleaves `x` (even bits) and `z` (odd bits).
+[[nodiscard]] constexpr std::uint64_t morton(std::uint32_t x, std::uint32_t z)
+{
+    return morton_spread(x) | (morton_spread(z) << 1);
+}
+
+static_assert(morton(0b11, 0b00) == 0b0101);
+static_assert(morton(0b00, 0b11) == 0b1010);
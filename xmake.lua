@@ -9,6 +9,14 @@ add_requires("glm")
 add_requires("nlohmann_json")
 add_requires("glfw")
 
+option("avx2")
+set_default(false)
+set_showmenu(true)
+set_description("Integrate bullet motion with AVX2 and FMA")
+add_defines("TANK_AVX2")
+add_cxflags("-mavx2", "-mfma")
+option_end()
+
 
 target("glad")
 set_kind("static")
@@ -19,11 +27,25 @@ set_kind("binary")
 set_rundir("$(projectdir)")
 add_files("tank-cli/**.cpp")
 add_deps("glad")
+add_options("avx2")
 add_packages("spdlog")
 add_packages("glm")
 add_packages("nlohmann_json")
 add_packages("glfw")
 
+target("ecs-bench")
+set_kind("binary")
+set_default(false)
+add_files("bench/ecs-storage.cpp")
+add_files("tank-cli/ecs/archetype-storage.cpp")
+add_files("tank-cli/ecs/bullet-pool.cpp")
+add_files("tank-cli/ecs/component-id.cpp")
+add_files("tank-cli/ecs/component-manager.cpp")
+add_files("tank-cli/ecs/motion-soa.cpp")
+add_options("avx2")
+add_packages("spdlog")
+add_packages("glm")
+
 --
 -- If you want to known more usage about xmake, please see https://xmake.io
 --